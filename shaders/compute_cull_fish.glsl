@@ -0,0 +1,78 @@
+#version 430 core
+
+// culls the packed fish instances against the frustum and fog, and compacts
+// the survivors into a range per distance bucket, counting them into the
+// indirect draws of each bucket, as cullFlock does on the cpu
+
+layout (local_size_x = 64) in;
+
+// BUCKETS, BUCKET_FADE, BUCKET_IMPOSTOR, COMMAND_FADE_IMPOSTOR and COMMAND_IMPOSTOR
+// are defined ahead of this by fish_culling, from fish_bucket and fish_command
+
+// the instance records, read and copied as words so either packing works
+layout (std430, binding = 0) readonly buffer instance_input {
+    uint inputWords[];
+};
+
+layout (std430, binding = 1) writeonly buffer instance_output {
+    uint outputWords[];
+};
+
+// DrawElementsIndirectCommand, count, instanceCount, firstIndex, baseVertex and baseInstance per draw
+#define COMMAND_WORDS 5
+layout (std430, binding = 2) buffer draw_commands {
+    uint commands[];
+};
+
+uniform int instanceCount;
+uniform int inputOffset; // the word the packed instances start from
+uniform int recordWords; // 8 for float records, 4 for quantized ones
+uniform bool quantized;
+uniform vec3 instanceScale = vec3(1.0);
+uniform vec3 instanceOffset = vec3(0.0);
+
+uniform vec4 planes[7]; // the frustum and fog planes, facing inwards
+uniform vec4 depthRow; // gives clip space w from a world position
+uniform float bucketDistances[BUCKETS - 1];
+uniform float radius;
+
+vec3 instancePosition(uint record) {
+    if (quantized) {
+        // x and y share the first word, z is the low half of the second
+        vec2 xy = unpackUnorm2x16(inputWords[record]);
+        float z = unpackUnorm2x16(inputWords[record + 1]).x;
+        return vec3(xy, z) * instanceScale + instanceOffset;
+    }
+
+    return vec3(
+        uintBitsToFloat(inputWords[record]),
+        uintBitsToFloat(inputWords[record + 1]),
+        uintBitsToFloat(inputWords[record + 2])
+    );
+}
+
+void main()
+{
+    int index = int(gl_GlobalInvocationID.x);
+    if (index >= instanceCount) return;
+
+    uint record = uint(inputOffset + index * recordWords);
+    vec3 position = instancePosition(record);
+    for (int plane = 0; plane < 7; plane++) {
+        if (dot(planes[plane].xyz, position) + planes[plane].w < -radius) return;
+    }
+
+    float w = dot(depthRow.xyz, position) + depthRow.w;
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && w > bucketDistances[bucket]) bucket++;
+
+    // fish fading out are drawn by two commands, with their impostors too
+    int command = bucket == BUCKET_IMPOSTOR ? COMMAND_IMPOSTOR : bucket;
+    uint slot = atomicAdd(commands[command * COMMAND_WORDS + 1], 1u);
+    if (bucket == BUCKET_FADE) atomicAdd(commands[COMMAND_FADE_IMPOSTOR * COMMAND_WORDS + 1], 1u);
+
+    uint target = uint((bucket * instanceCount + int(slot)) * recordWords);
+    for (int word = 0; word < recordWords; word++) {
+        outputWords[target + uint(word)] = inputWords[record + uint(word)];
+    }
+}
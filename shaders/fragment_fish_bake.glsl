@@ -0,0 +1,16 @@
+#version 410 core
+
+in vec3 normal;
+in vec2 texcoord;
+
+layout (location = 0) out vec4 albedo;
+layout (location = 1) out vec4 packedNormal;
+
+uniform sampler2D diffuse;
+
+// writes the unlit surface of the fish into the impostor atlas
+void main()
+{
+    albedo = vec4(texture(diffuse, texcoord).rgb, 1.0);
+    packedNormal = vec4(normalize(normal) * 0.5 + 0.5, 1.0);
+}
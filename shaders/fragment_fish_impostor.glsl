@@ -0,0 +1,116 @@
+#version 410 core
+
+in vec3 screen;
+in vec3 world;
+in vec2 texcoord;
+flat in float hueOffset;
+flat in float fadeDepth;
+flat in ivec2 phaseLayers;
+in float phaseBlend;
+
+out vec4 color;
+
+// the per-frame uniforms shared by every program, laid out as frame_uniforms in render.hpp
+layout (std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 fogColor;
+    vec4 backgroundColor;
+    float time;
+    int bpm;
+};
+
+// the baked albedo and normals of the fish, one layer per frame of the swim cycle
+uniform sampler2DArray impostorAlbedo;
+uniform sampler2DArray impostorNormal;
+
+uniform vec3 lightDir = vec3(0, -1, 0);
+uniform float ambientStrength = 0.5;
+uniform vec3 ambientColor = vec3(0.1, 0.4, 0.7);
+
+// the depths over which impostors fade in, taking over from the fish
+uniform vec2 fadeRange = vec2(-2, -1);
+
+#define PI 3.14
+
+// sourced from https://gist.github.com/mairod/a75e7b44f68110e1576d77419d608786
+vec3 hueShift(vec3 color, float hueAdjust){
+    const vec3 kRGBToYPrime = vec3(0.299, 0.587, 0.114);
+    const vec3 kRGBToI      = vec3(0.596, -0.275, -0.321);
+    const vec3 kRGBToQ      = vec3(0.212, -0.523, 0.311);
+    const vec3 kYIQToR = vec3(1.0, 0.956, 0.621);
+    const vec3 kYIQToG = vec3(1.0, -0.272, -0.647);
+    const vec3 kYIQToB = vec3(1.0, -1.107, 1.704);
+
+    float YPrime = dot(color, kRGBToYPrime);
+    float I      = dot(color, kRGBToI);
+    float Q      = dot(color, kRGBToQ);
+    float hue    = atan(Q, I);
+    float chroma = sqrt(I * I + Q * Q);
+
+    hue += hueAdjust;
+    Q = chroma * sin(hue);
+    I = chroma * cos(hue);
+
+    vec3 yIQ = vec3(YPrime, I, Q);
+    return vec3(dot(yIQ, kYIQToR), dot(yIQ, kYIQToG), dot(yIQ, kYIQToB));
+}
+
+// a 4x4 ordered dither, so fading fish and impostors cover complementary pixels
+float dither() {
+    const float bayer[16] = float[](
+        0, 8, 2, 10,
+        12, 4, 14, 6,
+        3, 11, 1, 9,
+        15, 7, 13, 5
+    );
+    ivec2 pixel = ivec2(gl_FragCoord.xy) % 4;
+    return (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+}
+
+// the same lighting as fragment_party_fish.glsl, from the baked surface
+void main()
+{
+    float fade = clamp((fadeDepth - fadeRange.x) / (fadeRange.y - fadeRange.x), 0.0, 1.0);
+    if (dither() >= fade) discard;
+
+    vec4 albedoSample = mix(
+        texture(impostorAlbedo, vec3(texcoord, phaseLayers.x)),
+        texture(impostorAlbedo, vec3(texcoord, phaseLayers.y)),
+        phaseBlend
+    );
+    if (albedoSample.a < 0.5) discard;
+
+    vec4 normalSample = mix(
+        texture(impostorNormal, vec3(texcoord, phaseLayers.x)),
+        texture(impostorNormal, vec3(texcoord, phaseLayers.y)),
+        phaseBlend
+    );
+
+    // the mip levels average in the empty space around the fish, so divide it back out
+    vec3 albedo = hueShift(albedoSample.rgb / albedoSample.a, hueOffset * PI * 2);
+
+    // calculate ambient contribution
+    vec3 ambient = ambientStrength * ambientColor * albedo;
+
+    // calculate diffuse contribution
+    vec3 lightDir = normalize(lightDir);
+    vec3 normal = normalize(normalSample.xyz / normalSample.a * 2.0 - 1.0);
+    float diffuseAmount = max(dot(lightDir, normal), 0.0);
+    vec3 diffuse = diffuseAmount * albedo * 1.2f;
+
+    // calculate specular contribution
+    vec3 viewDir = normalize(cameraPos.xyz - world);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+    vec3 specular = vec3(0.5) * spec;
+
+    // calculate light flash
+    vec3 light = mix(ambient + diffuse + specular, vec3(0.04, 0.08, 0.15), (sin(time * 2 * PI * (bpm / 60)) + 1.4) / 3);
+    // calculate fog
+    vec3 fog = mix(fogColor.rgb, backgroundColor.rgb, smoothstep(40.0, 150.0, screen.z));
+
+    color = vec4(mix(light, fog, smoothstep(20.0, 60.0, screen.z)), 1.0);
+}
@@ -5,52 +5,55 @@ in vec3 world;
 in vec3 normal;
 in vec2 texcoord;
 in float hueOffset;
+flat in float fadeDepth;
 
 out vec4 color;
 
-uniform vec3 cameraPos;
-uniform float time;
-
-uniform sampler2D diffuse;
+// the per-frame uniforms shared by every program, laid out as frame_uniforms in render.hpp
+layout (std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 fogColor;
+    vec4 backgroundColor;
+    float time;
+    int bpm;
+};
+
+uniform sampler2DArray diffuseHues; // the diffuse texture, with a layer per hue
+uniform int hueVariants;
 uniform sampler2D metallic;
 uniform sampler2D roughness;
 
 uniform vec3 lightDir = vec3(0, -1, 0);
-uniform int bpm = 125;
 uniform float ambientStrength = 0.5;
-uniform vec3 fogColor = vec3(20, 23, 55) / 255;
 uniform vec3 ambientColor = vec3(0.1, 0.4, 0.7);
-uniform vec3 backgroundColor = vec3(0.1, 0.12, 0.33);
-
-#define PI 3.14
 
-// sourced from https://gist.github.com/mairod/a75e7b44f68110e1576d77419d608786
-vec3 hueShift(vec3 color, float hueAdjust){
-    const vec3 kRGBToYPrime = vec3(0.299, 0.587, 0.114);
-    const vec3 kRGBToI      = vec3(0.596, -0.275, -0.321);
-    const vec3 kRGBToQ      = vec3(0.212, -0.523, 0.311);
-    const vec3 kYIQToR = vec3(1.0, 0.956, 0.621);
-    const vec3 kYIQToG = vec3(1.0, -0.272, -0.647);
-    const vec3 kYIQToB = vec3(1.0, -1.107, 1.704);
+// the depths over which fish fade out, dissolving into their impostors
+uniform vec2 fadeRange = vec2(1e9, 2e9);
 
-    float YPrime = dot(color, kRGBToYPrime);
-    float I      = dot(color, kRGBToI);
-    float Q      = dot(color, kRGBToQ);
-    float hue    = atan(Q, I);
-    float chroma = sqrt(I * I + Q * Q);
-
-    hue += hueAdjust;
-    Q = chroma * sin(hue);
-    I = chroma * cos(hue);
+#define PI 3.14
 
-    vec3 yIQ = vec3(YPrime, I, Q);
-    return vec3(dot(yIQ, kYIQToR), dot(yIQ, kYIQToG), dot(yIQ, kYIQToB));
+// a 4x4 ordered dither, so fading fish and impostors cover complementary pixels
+float dither() {
+    const float bayer[16] = float[](
+        0, 8, 2, 10,
+        12, 4, 14, 6,
+        3, 11, 1, 9,
+        15, 7, 13, 5
+    );
+    ivec2 pixel = ivec2(gl_FragCoord.xy) % 4;
+    return (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
 }
 
 // blinn-phong with directional lighting to imitate the sun
 void main()
 {
-    vec3 albedo = hueShift(texture(diffuse, texcoord).rgb, hueOffset * PI * 2);
+    float fade = clamp((fadeDepth - fadeRange.x) / (fadeRange.y - fadeRange.x), 0.0, 1.0);
+    if (dither() < fade) discard;
+
+    vec3 albedo = texture(diffuseHues, vec3(texcoord, hueOffset * hueVariants)).rgb;
 
     // calculate ambient contribution
     vec3 ambient = ambientStrength * ambientColor * albedo;
@@ -62,7 +65,7 @@ void main()
     vec3 diffuse = diffuseAmount * albedo * 1.2f;
 
     // calculate specular contribution
-    vec3 viewDir = normalize(cameraPos - world);
+    vec3 viewDir = normalize(cameraPos.xyz - world);
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
     vec3 specular = vec3(0.5) * spec;
@@ -70,7 +73,7 @@ void main()
     // calculate light flash
     vec3 light = mix(ambient + diffuse + specular, vec3(0.04, 0.08, 0.15), (sin(time * 2 * PI * (bpm / 60)) + 1.4) / 3);
     // calculate fog
-    vec3 fog = mix(fogColor, backgroundColor, smoothstep(40.0, 150.0, screen.z));
+    vec3 fog = mix(fogColor.rgb, backgroundColor.rgb, smoothstep(40.0, 150.0, screen.z));
 
     color = vec4(mix(light, fog, smoothstep(20.0, 60.0, screen.z)), 1.0);
 }
\ No newline at end of file
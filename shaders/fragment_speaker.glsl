@@ -7,15 +7,21 @@ in vec2 texcoord;
 
 out vec4 color;
 
-uniform vec3 cameraPos;
-uniform float time;
+// the per-frame uniforms shared by every program, laid out as frame_uniforms in render.hpp
+layout (std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 fogColor;
+    vec4 backgroundColor;
+    float time;
+    int bpm;
+};
 
 uniform vec3 lightDir = vec3(0, -1, 0);
-uniform int bpm = 125;
 uniform float ambientStrength = 0.5;
-uniform vec3 fogColor = vec3(20, 23, 55) / 255;
 uniform vec3 ambientColor = vec3(0.1, 0.4, 0.7);
-uniform vec3 backgroundColor = vec3(0.1, 0.12, 0.33);
 
 #define PI 3.14
 
@@ -34,7 +40,7 @@ void main()
     vec3 diffuse = diffuseAmount * albedo * 1.2f;
 
     // calculate specular contribution
-    vec3 viewDir = normalize(cameraPos - world);
+    vec3 viewDir = normalize(cameraPos.xyz - world);
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
     vec3 specular = vec3(0.5) * spec;
@@ -42,7 +48,7 @@ void main()
     // calculate light flash
     vec3 light = mix(ambient + diffuse + specular, vec3(0.04, 0.08, 0.15), (sin(time * 2 * PI * (bpm / 60)) + 1.4) / 3);
     // calculate fog
-    vec3 fog = mix(fogColor, backgroundColor, smoothstep(40.0, 150.0, screen.z));
+    vec3 fog = mix(fogColor.rgb, backgroundColor.rgb, smoothstep(40.0, 150.0, screen.z));
 
     color = vec4(mix(light, fog, smoothstep(20.0, 60.0, screen.z)), 1.0);
 }
\ No newline at end of file
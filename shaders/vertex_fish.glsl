@@ -1,22 +1,48 @@
 #version 410 core
 
 layout (location = 0) in vec3 positionAttribute;
-layout (location = 1) in vec3 normalAttribute;
+layout (location = 1) in vec2 normalAttribute; // octahedral encoded
 layout (location = 2) in vec2 texcoordAttribute;
-layout (location = 3) in mat4 mvpMatrixInstance;
-// 4
-// 5 in use by the matrix instance
-// 6
-layout (location = 7) in float timeOffsetInstance;
-layout (location = 8) in float hueOffsetInstance;
+layout (location = 3) in vec4 positionInstance;
+layout (location = 4) in vec4 orientationInstance;
 
 out vec3 screen;
 out vec3 world;
 out vec3 normal;
 out vec2 texcoord;
 out float hueOffset;
+flat out float fadeDepth;
 
-uniform float time;
+// the per-frame uniforms shared by every program, laid out as frame_uniforms in render.hpp
+layout (std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 fogColor;
+    vec4 backgroundColor;
+    float time;
+    int bpm;
+};
+
+// maps quantized instance positions back into world space
+uniform vec3 instanceScale = vec3(1.0);
+uniform vec3 instanceOffset = vec3(0.0);
+
+// the time offset and hue shift of each fish, looked up by the slot in the position's w
+uniform samplerBuffer instanceAttributes;
+uniform float instanceSlotScale = 1.0;
+
+// the swim cycle baked per vertex, with a band of rows per frame, used instead of working it out
+uniform bool bakedAnimation = false;
+uniform sampler2D swimAnimation;
+uniform int swimFrames;
+uniform float swimPeriod;
+uniform int swimBaseVertex; // where the model starts in the geometry pool, so column 0 is its first vertex
+uniform int swimWidth; // the vertices in each row, those past it wrap onto the next
+uniform int swimRows; // the rows each frame takes up
+
+float timeOffsetInstance;
 
 #define PI 3.14
 
@@ -56,6 +82,21 @@ vec3 swim(vec3 modelSpace) {
     );
 }
 
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unfolds a normal packed by octEncode in geometry_pool.cpp
+vec3 octDecode(vec2 p) {
+    vec3 d = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0) d.xy = (1.0 - abs(d.yx)) * signNotZero(d.xy);
+    return normalize(d);
+}
+
 vec3 translate() {
     float loc = sin((time + timeOffsetInstance) * (3 * PI) / 2) * 0.3;
     return vec3(pow(abs(loc), 0.77) / 6 * sign(loc), 0, 0);
@@ -63,20 +104,42 @@ vec3 translate() {
 
 void main()
 {
+    int slot = int(round(positionInstance.w * instanceSlotScale));
+    vec2 attributes = texelFetch(instanceAttributes, slot).xy;
+    timeOffsetInstance = attributes.x;
+
     // apply model space transformations
     vec3 modelSpace = positionAttribute;
-    modelSpace = swim(modelSpace);
-    modelSpace = twist(modelSpace);
-    modelSpace = yaw(modelSpace);
-    modelSpace += translate();
+    if (bakedAnimation) {
+        float frame = fract((time + timeOffsetInstance) / swimPeriod) * swimFrames;
+        int current = int(frame);
+        int next = (current + 1) % swimFrames;
+        int vertex = gl_VertexID - swimBaseVertex;
+        ivec2 texel = ivec2(vertex % swimWidth, vertex / swimWidth);
+        modelSpace = mix(
+            texelFetch(swimAnimation, texel + ivec2(0, current * swimRows), 0).xyz,
+            texelFetch(swimAnimation, texel + ivec2(0, next * swimRows), 0).xyz,
+            fract(frame)
+        );
+    } else {
+        modelSpace = swim(modelSpace);
+        modelSpace = twist(modelSpace);
+        modelSpace = yaw(modelSpace);
+        modelSpace += translate();
+    }
+
+    // place the model using the instance orientation and position
+    vec3 instancePosition = positionInstance.xyz * instanceScale + instanceOffset;
+    vec3 worldSpace = rotate(normalize(orientationInstance), modelSpace) + instancePosition;
+    fadeDepth = (viewProjection * vec4(instancePosition, 1.0)).w;
 
     // set vertex position
-    gl_Position = mvpMatrixInstance * vec4(modelSpace, 1.0);
+    gl_Position = viewProjection * vec4(worldSpace, 1.0);
 
     // export normals and texture coordinates
     screen = gl_Position.xyz;
     world = positionAttribute;
-    normal = normalAttribute;
+    normal = octDecode(normalAttribute);
     texcoord = texcoordAttribute;
-    hueOffset = hueOffsetInstance;
+    hueOffset = attributes.y;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#version 410 core
+
+layout (location = 0) in vec3 positionAttribute; // the corners of the quad, in x and z
+layout (location = 3) in vec4 positionInstance;
+layout (location = 4) in vec4 orientationInstance;
+
+out vec3 screen;
+out vec3 world;
+out vec2 texcoord;
+flat out float hueOffset;
+flat out float fadeDepth;
+flat out ivec2 phaseLayers;
+out float phaseBlend;
+
+// the per-frame uniforms shared by every program, laid out as frame_uniforms in render.hpp
+layout (std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 fogColor;
+    vec4 backgroundColor;
+    float time;
+    int bpm;
+};
+
+// maps quantized instance positions back into world space
+uniform vec3 instanceScale = vec3(1.0);
+uniform vec3 instanceOffset = vec3(0.0);
+
+// the time offset and hue shift of each fish, looked up by the slot in the position's w
+uniform samplerBuffer instanceAttributes;
+uniform float instanceSlotScale = 1.0;
+
+uniform float impostorRadius;
+uniform int impostorGrid;
+uniform int impostorPhases;
+uniform float impostorPeriod;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// maps a direction onto the octahedron unfolded into a square
+vec2 octEncode(vec3 d) {
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    return d.z >= 0.0 ? d.xy : (1.0 - abs(d.yx)) * signNotZero(d.xy);
+}
+
+vec3 octDecode(vec2 p) {
+    vec3 d = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0) d.xy = (1.0 - abs(d.yx)) * signNotZero(d.xy);
+    return normalize(d);
+}
+
+void main()
+{
+    int slot = int(round(positionInstance.w * instanceSlotScale));
+    vec2 attributes = texelFetch(instanceAttributes, slot).xy;
+
+    vec3 instancePosition = positionInstance.xyz * instanceScale + instanceOffset;
+    vec4 orientation = normalize(orientationInstance);
+
+    // pick the view in the atlas closest to the direction of the camera from the fish
+    vec3 toCamera = rotate(vec4(-orientation.xyz, orientation.w), normalize(cameraPos.xyz - instancePosition));
+    vec2 tile = clamp(floor((octEncode(toCamera) * 0.5 + 0.5) * impostorGrid), 0.0, impostorGrid - 1.0);
+    vec3 view = octDecode((tile + 0.5) / impostorGrid * 2.0 - 1.0);
+
+    // face the quad the same way as the camera which baked that view
+    vec3 forward = -view;
+    vec3 right = normalize(cross(forward, vec3(0, 1, 0)));
+    vec3 up = cross(right, forward);
+    vec2 corner = positionAttribute.xz;
+    vec3 modelSpace = (right * corner.x + up * corner.y) * impostorRadius;
+
+    gl_Position = viewProjection * vec4(rotate(orientation, modelSpace) + instancePosition, 1.0);
+
+    // blend between the two baked frames of the swim cycle either side of this fish's
+    float phase = fract((time + attributes.x) / impostorPeriod) * impostorPhases;
+    phaseLayers = ivec2(int(phase), (int(phase) + 1) % impostorPhases);
+    phaseBlend = fract(phase);
+
+    screen = gl_Position.xyz;
+    world = instancePosition;
+    texcoord = (tile + corner * 0.5 + 0.5) / impostorGrid;
+    hueOffset = attributes.y;
+    fadeDepth = (viewProjection * vec4(instancePosition, 1.0)).w;
+}
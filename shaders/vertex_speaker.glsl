@@ -1,16 +1,27 @@
 #version 410 core
 
 layout (location = 0) in vec3 positionAttribute;
-layout (location = 1) in vec3 normalAttribute;
+layout (location = 1) in vec2 normalAttribute; // octahedral encoded
 layout (location = 2) in vec2 texcoordAttribute;
+layout (location = 3) in mat4 modelInstance; // the world matrix of each instance, in locations 3 to 6
 
 out vec3 screen;
 out vec3 world;
 out vec3 normal;
 out vec2 texcoord;
 
-uniform mat4 mvp;
-uniform float time;
+// the per-frame uniforms shared by every program, laid out as frame_uniforms in render.hpp
+layout (std140) uniform frame_data {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPos;
+    vec4 fogColor;
+    vec4 backgroundColor;
+    float time;
+    int bpm;
+};
+
 uniform float timeOffset;
 
 #define PI 3.14
@@ -62,6 +73,17 @@ vec3 translate(vec3 worldSpace) {
     return vec3(pow(abs(loc), 0.77) / 6 * sign(loc), 0, 0);
 }
 
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unfolds a normal packed by octEncode in geometry_pool.cpp
+vec3 octDecode(vec2 p) {
+    vec3 d = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0) d.xy = (1.0 - abs(d.yx)) * signNotZero(d.xy);
+    return normalize(d);
+}
+
 void main()
 {
     vec3 modelSpace = positionAttribute;
@@ -70,11 +92,11 @@ void main()
     modelSpace = yaw(modelSpace);
     modelSpace += translate(positionAttribute);
 
-    gl_Position = mvp * vec4(modelSpace, 1.0);
+    gl_Position = viewProjection * modelInstance * vec4(modelSpace, 1.0);
 
     // export normals and texture coordinates
     screen = gl_Position.xyz;
     world = positionAttribute;
-    normal = normalAttribute;
+    normal = octDecode(normalAttribute);
     texcoord = texcoordAttribute;
 }
\ No newline at end of file
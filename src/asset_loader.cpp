@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+#include <glm/glm.hpp>
+
+#include "asset_loader.hpp"
+#include "gl_state.hpp"
+#include "mesh/simplify.hpp"
+#include "texture/ktx.hpp"
+
+/**
+ * Rotates the hue of a colour in YIQ space, the same way fragment_party_fish.glsl used to.
+ * sourced from https://gist.github.com/mairod/a75e7b44f68110e1576d77419d608786
+ */
+static glm::vec3 hueShift(glm::vec3 color, float hueAdjust) {
+    const glm::vec3 kRGBToYPrime = glm::vec3(0.299, 0.587, 0.114);
+    const glm::vec3 kRGBToI = glm::vec3(0.596, -0.275, -0.321);
+    const glm::vec3 kRGBToQ = glm::vec3(0.212, -0.523, 0.311);
+    const glm::vec3 kYIQToR = glm::vec3(1.0, 0.956, 0.621);
+    const glm::vec3 kYIQToG = glm::vec3(1.0, -0.272, -0.647);
+    const glm::vec3 kYIQToB = glm::vec3(1.0, -1.107, 1.704);
+
+    float YPrime = glm::dot(color, kRGBToYPrime);
+    float I = glm::dot(color, kRGBToI);
+    float Q = glm::dot(color, kRGBToQ);
+    float hue = std::atan2(Q, I);
+    float chroma = std::sqrt(I * I + Q * Q);
+
+    hue += hueAdjust;
+    Q = chroma * std::sin(hue);
+    I = chroma * std::cos(hue);
+
+    glm::vec3 yIQ = glm::vec3(YPrime, I, Q);
+    return glm::vec3(glm::dot(yIQ, kYIQToR), glm::dot(yIQ, kYIQToG), glm::dot(yIQ, kYIQToB));
+}
+
+/**
+ * Gets the compressed format a ktx2 format is uploaded as, or 0 if the driver can't sample it.
+ */
+static GLint compressedFormat(uint32_t format) {
+    switch (format) {
+        case KTX_FORMAT_BC1_RGB:
+            return GLAD_GL_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+        case KTX_FORMAT_BC3:
+            return GLAD_GL_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+        case KTX_FORMAT_BC7:
+            return GLAD_GL_VERSION_4_2 ? GL_COMPRESSED_RGBA_BPTC_UNORM : 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Decodes a texture as bytes, with three or four channels. The copy compressed
+ * by texbake is used instead where there is one the driver can sample, its
+ * blocks and mips uploaded as they are.
+ */
+static bool decodeTexture(const std::string &file, std::optional<GLuint> material_textures::*slot,
+                          decoded_model &model) {
+    ktx_texture compressed;
+    if (readKtx(ktxTexturePath(file), compressed) && compressedFormat(compressed.format)) {
+        // every level is there, so the mips texbake made are sampled rather than only the full size
+        decoded_image image{file, slot, GL_TEXTURE_2D, compressedFormat(compressed.format), GL_LINEAR_MIPMAP_LINEAR,
+                            (GLsizei) compressed.width, (GLsizei) compressed.height, 1, 0, 0, {}, {}};
+        for (const std::vector<uint8_t> &level : compressed.levels) {
+            image.levels.push_back(image.pixels.size());
+            image.pixels.insert(image.pixels.end(), level.begin(), level.end());
+        }
+        model.images.push_back(std::move(image));
+        return true;
+    }
+
+    int components;
+    int image_width, image_height;
+    uint8_t *image = stbi_load(file.c_str(), &image_width, &image_height, &components, STBI_default);
+    if (!image) {
+        model.error = "Unable to load texture: " + file;
+        return false;
+    }
+    if (components != 3 && components != 4) {
+        stbi_image_free(image);
+        model.error = "Unable to load texture with " + std::to_string(components) + " components: " + file;
+        return false;
+    }
+
+    const GLenum format = components == 3 ? GL_RGB : GL_RGBA;
+    const size_t bytes = (size_t) image_width * image_height * components;
+    model.images.push_back({file, slot, GL_TEXTURE_2D, (GLint) format, GL_LINEAR, image_width, image_height, 1,
+                            format, GL_UNSIGNED_BYTE, std::vector<uint8_t>(image, image + bytes), {}});
+    stbi_image_free(image);
+    return true;
+}
+
+/**
+ * Decodes a texture into an array with a layer for each evenly spaced hue shift,
+ * so shaders can pick a layer rather than shifting every fragment.
+ * Half floats keep the colours which the shift pushes out of range.
+ */
+static bool decodeHueTextures(const std::string &file, int variants, decoded_model &model) {
+    int components;
+    int image_width, image_height;
+    uint8_t *image = stbi_load(file.c_str(), &image_width, &image_height, &components, STBI_rgb);
+    if (!image) {
+        model.error = "Unable to load texture: " + file;
+        return false;
+    }
+
+    const size_t texels = (size_t) image_width * image_height;
+    std::vector<uint8_t> pixels(texels * variants * sizeof(glm::vec3));
+    auto *layers = reinterpret_cast<glm::vec3 *>(pixels.data());
+    for (int layer = 0; layer < variants; layer++) {
+        const float hueAdjust = (float) layer / (float) variants * 3.14f * 2;
+        for (size_t texel = 0; texel < texels; texel++) {
+            const uint8_t *rgb = image + texel * 3;
+            const glm::vec3 color = glm::vec3(rgb[0], rgb[1], rgb[2]) / 255.0f;
+            layers[layer * texels + texel] = hueShift(color, hueAdjust);
+        }
+    }
+    stbi_image_free(image);
+
+    model.images.push_back({file, &material_textures::diffuseHues, GL_TEXTURE_2D_ARRAY, GL_RGB16F,
+                            GL_LINEAR_MIPMAP_LINEAR, image_width, image_height, variants, GL_RGB, GL_FLOAT,
+                            std::move(pixels), {}});
+    return true;
+}
+
+/**
+ * Maps or parses a model and decodes its material's textures.
+ * Runs on a loader thread, so failures are left for the GL thread to report.
+ *
+ * todo(arlyon) only supports loading some well-defined textures
+ */
+static void decodeModel(decoded_model &model, int hueVariants) {
+    // the copy baked by meshbake is mapped straight in, the obj is only parsed when there isn't one
+    auto baked = std::make_unique<mapped_mesh>();
+    if (baked->open(bakedMeshPath(model.path))) {
+        model.mesh = baked->view();
+        model.baked = std::move(baked);
+    } else {
+        // a large obj is parsed across the thread pool, alongside whatever the frame runs on it
+        obj_model obj;
+        if (!loadObj(model.path, obj)) {
+            model.error = "Couldn't load file " + model.path + ".";
+            return;
+        }
+
+        if (!bakeMesh(obj, model.parsed)) {
+            model.error = "Error parsing geometry for " + model.path + ". Are you only using triangles?";
+            return;
+        }
+        model.mesh = model.parsed.view();
+    }
+
+    const baked_textures &material = model.mesh.textures;
+    if (!material.diffuse.empty() && !decodeTexture(material.diffuse, &material_textures::diffuse, model)) return;
+    if (!material.roughness.empty() && !decodeTexture(material.roughness, &material_textures::roughness, model)) return;
+    if (!material.metallic.empty() && !decodeTexture(material.metallic, &material_textures::metallic, model)) return;
+    if (!material.diffuse.empty() && hueVariants > 0) decodeHueTextures(material.diffuse, hueVariants, model);
+}
+
+/**
+ * Creates a texture from the pixels in the bound pixel unpack buffer.
+ */
+static GLuint createTexture(const decoded_image &image) {
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    gl_state::getInstance().bindTexture(image.target, texture_id);
+
+    glTexParameteri(image.target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(image.target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(image.target, GL_TEXTURE_MIN_FILTER, image.minFilter);
+    glTexParameteri(image.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (!image.levels.empty()) {
+        // compressed with its mips already made, so each level is made from where it was staged
+        for (size_t level = 0; level < image.levels.size(); level++) {
+            const size_t end = level + 1 < image.levels.size() ? image.levels[level + 1] : image.pixels.size();
+            // see https://stackoverflow.com/a/26283148/4913983
+            GLvoid const *offset = static_cast<char const *>(0) + image.levels[level];
+            glCompressedTexImage2D(image.target, (GLint) level, (GLenum) image.internalFormat,
+                                   std::max(image.width >> level, 1), std::max(image.height >> level, 1), 0,
+                                   (GLsizei) (end - image.levels[level]), offset);
+        }
+        glTexParameteri(image.target, GL_TEXTURE_MAX_LEVEL, (GLint) image.levels.size() - 1);
+
+        std::cout << "Loaded compressed texture " << texture_id << ": " << image.file << std::endl;
+        return texture_id;
+    }
+
+    if (image.target == GL_TEXTURE_2D_ARRAY) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, image.internalFormat, image.width, image.height, image.layers, 0,
+                     image.format, image.type, nullptr);
+    } else {
+        glTexImage2D(image.target, 0, image.internalFormat, image.width, image.height, 0, image.format, image.type,
+                     nullptr);
+    }
+    glGenerateMipmap(image.target);
+
+    std::cout << "Loaded texture " << texture_id << ": " << image.file << std::endl;
+    return texture_id;
+}
+
+asset_loader::asset_loader() {
+    for (int i = 0; i < ASSET_LOADER_THREADS; i++) this->workers.emplace_back(&asset_loader::run, this);
+}
+
+asset_loader::~asset_loader() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto &worker : this->workers) worker.join();
+}
+
+void asset_loader::run() {
+    for (;;) {
+        load_job job;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+            if (this->stopping) return;
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+
+        auto model = std::make_unique<decoded_model>();
+        model->path = job.path;
+        model->target = std::move(job.target);
+        decodeModel(*model, job.hueVariants);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->decoded.push_back(std::move(model));
+    }
+}
+
+void asset_loader::load(const std::string &path, int hueVariants, std::shared_ptr<model_assets> target) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back({path, hueVariants, std::move(target)});
+        this->queued++;
+    }
+    this->wake.notify_one();
+}
+
+void asset_loader::usePlaceholder(model_assets &assets) {
+    if (this->placeholder.empty()) {
+        // an octahedron with a flat normal on each face, wound anticlockwise from outside
+        std::vector<packed_vertex> vertices;
+        std::vector<uint32_t> indices;
+        for (float x : {-1.0f, 1.0f}) {
+            for (float y : {-1.0f, 1.0f}) {
+                for (float z : {-1.0f, 1.0f}) {
+                    const glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
+                    glm::vec3 corners[3] = {glm::vec3(x, 0, 0), glm::vec3(0, y, 0), glm::vec3(0, 0, z)};
+                    if (x * y * z < 0) std::swap(corners[1], corners[2]);
+                    for (const glm::vec3 &corner : corners) {
+                        const glm::vec3 position = corner * PLACEHOLDER_RADIUS;
+                        const float vertex[VERTEX_FLOATS] = {position.x, position.y, position.z,
+                                                             normal.x, normal.y, normal.z, 0.0f, 0.0f};
+                        indices.push_back((uint32_t) vertices.size());
+                        vertices.push_back(packVertex(vertex));
+                    }
+                }
+            }
+        }
+
+        const pool_range range = geometry_pool::getInstance().allocate(vertices.data(), vertices.size(),
+                                                                       indices.data(), indices.size());
+        this->placeholder = {{range.firstIndex, (GLsizei) indices.size(), range.baseVertex}};
+        this->placeholderVertices = (GLsizei) vertices.size();
+    }
+
+    assets.lods = this->placeholder;
+    assets.vertexCount = this->placeholderVertices;
+    assets.boundingRadius = PLACEHOLDER_RADIUS;
+    assets.textures = {};
+    assets.resident = false;
+}
+
+size_t asset_loader::upload(size_t budget) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        std::move(this->decoded.begin(), this->decoded.end(), std::back_inserter(this->uploads));
+        this->decoded.clear();
+    }
+
+    size_t spent = 0;
+    while (!this->uploads.empty() && (spent < budget || spent == 0)) {
+        decoded_model &model = *this->uploads.front();
+        if (!model.error.empty()) {
+            std::cerr << model.error << std::endl;
+            std::exit(1);
+        }
+
+        spent += this->uploadPart(model, budget > spent ? budget - spent : 0);
+        if (this->progress.part == 2 + model.images.size()) {
+            this->publish(model);
+            this->uploads.pop_front();
+            this->progress = {};
+        }
+    }
+    return spent;
+}
+
+/**
+ * Copies as much of the current part of a model as fits in the budget, in whole elements
+ * but always at least one, moving on to the next part once it's all gone across.
+ */
+size_t asset_loader::uploadPart(decoded_model &model, size_t budget) {
+    upload_progress &current = this->progress;
+    geometry_pool &pool = geometry_pool::getInstance();
+    const mesh_view &mesh = model.mesh;
+    if (current.part == 0 && current.done == 0) current.range = pool.reserve(mesh.vertexCount, mesh.indexCount);
+
+    size_t total, element;
+    if (current.part == 0) {
+        total = mesh.vertexCount * sizeof(packed_vertex);
+        element = sizeof(packed_vertex);
+    } else if (current.part == 1) {
+        total = mesh.indexCount * sizeof(uint32_t);
+        element = sizeof(uint32_t);
+    } else {
+        total = model.images[current.part - 2].pixels.size();
+        element = 1;
+    }
+    const size_t bytes = std::min(total - current.done, std::max<size_t>(budget / element, 1) * element);
+    const size_t first = current.done / element;
+
+    if (current.part == 0) {
+        pool.writeVertices(current.range.baseVertex + (GLint) first, mesh.vertices + first, bytes / element);
+    } else if (current.part == 1) {
+        pool.writeIndices(current.range.firstIndex + (GLuint) first, mesh.indices + first, bytes / element);
+    } else {
+        // pixels are staged in an unpack buffer, given fresh storage for each image so the
+        // last can still be read from, and the texture is made from it once they're all there
+        const decoded_image &image = model.images[current.part - 2];
+        gl_state &state = gl_state::getInstance();
+        if (!this->stagingBuffer) glGenBuffers(1, &this->stagingBuffer);
+        state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, this->stagingBuffer);
+        if (current.done == 0) glBufferData(GL_PIXEL_UNPACK_BUFFER, total, nullptr, GL_STREAM_DRAW);
+
+        void *staged = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, current.done, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        std::memcpy(staged, image.pixels.data() + current.done, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (current.done + bytes == total) current.textures.*image.slot = createTexture(image);
+
+        // everything else uploads textures from client memory, which needs nothing bound here
+        state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    current.done += bytes;
+    if (current.done == total) {
+        current.part++;
+        current.done = 0;
+    }
+    return bytes;
+}
+
+void asset_loader::publish(decoded_model &model) {
+    // the levels of detail were laid out from 0, so move them to where the model landed in the pool
+    model_assets &assets = *model.target;
+    const pool_range &range = this->progress.range;
+    assets.lods.clear();
+    for (const baked_lod &lod : model.mesh.lods) {
+        assets.lods.push_back({range.firstIndex + lod.firstIndex, (GLsizei) lod.indices, range.baseVertex});
+    }
+    assets.vertexCount = (GLsizei) model.mesh.vertexCount;
+    assets.boundingRadius = model.mesh.boundingRadius;
+    assets.textures = this->progress.textures;
+    assets.resident = true;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->queued--;
+}
+
+size_t asset_loader::pending() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->queued;
+}
+
+void asset_loader::close() {
+    this->uploads.clear();
+    this->progress = {};
+    gl_state::getInstance().deleteBuffer(this->stagingBuffer);
+    this->stagingBuffer = 0;
+}
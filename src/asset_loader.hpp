@@ -0,0 +1,139 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+
+#include "components/render.hpp"
+#include "geometry_pool.hpp"
+
+#define ASSET_LOADER_THREADS 2 // the threads decoding models and images, which share the thread pool with the frame
+#define PLACEHOLDER_RADIUS 1.0f // the size of the octahedron drawn for a model which hasn't loaded yet
+
+/**
+ * An image decoded into the layout it's uploaded in, with the
+ * material slot its texture goes into once it's resident.
+ */
+struct decoded_image {
+    std::string file;
+    std::optional<GLuint> material_textures::*slot;
+    GLenum target; // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for the hue layers
+    GLint internalFormat;
+    GLint minFilter;
+    GLsizei width, height, layers;
+    GLenum format, type; // of the pixels, when they aren't compressed
+    std::vector<uint8_t> pixels;
+    std::vector<size_t> levels; // where each mip level starts in the pixels, when they were compressed by texbake
+};
+
+/**
+ * A model read from disk and its images decoded, waiting to be uploaded.
+ */
+struct decoded_model {
+    std::string path;
+    std::shared_ptr<model_assets> target;
+    std::unique_ptr<mapped_mesh> baked; // the baked mesh the view points into, if there was one
+    mesh_data parsed; // the mesh built from the obj, otherwise
+    mesh_view mesh;
+    std::vector<decoded_image> images;
+    std::string error; // why it couldn't be loaded, if it couldn't
+};
+
+/**
+ * Loads models and their textures without holding up the frame. Loader
+ * threads map or parse each model and decode its images, then the GL
+ * thread copies a budgeted number of bytes of them to the gpu every
+ * frame: geometry straight into space reserved in the geometry pool,
+ * pixels through a pixel unpack buffer. A model is only published into
+ * its model_assets once all of it has gone across, until then it is
+ * drawn as a placeholder octahedron.
+ */
+class asset_loader {
+public:
+    static asset_loader &getInstance() {
+        static asset_loader instance;
+        return instance;
+    }
+
+    asset_loader(asset_loader const &) = delete;
+
+    void operator=(asset_loader const &) = delete;
+
+    ~asset_loader();
+
+    /**
+     * Queues a model and its material's textures to be loaded into the given assets.
+     * @param hueVariants The number of hue shifted copies of the diffuse texture to make, if any.
+     */
+    void load(const std::string &path, int hueVariants, std::shared_ptr<model_assets> target);
+
+    /**
+     * Points a model's assets at the placeholder mesh, which is
+     * uploaded the first time it's needed.
+     * @note Should only be called from the GL thread.
+     */
+    void usePlaceholder(model_assets &assets);
+
+    /**
+     * Copies decoded models to the gpu until the budget is spent, carrying
+     * on from wherever the last call left off, and publishes any which
+     * are finished. At least one piece is copied each call.
+     * @param budget The bytes to copy this call.
+     * @returns The bytes copied.
+     * @note Should only be called from the GL thread, once per frame.
+     */
+    size_t upload(size_t budget);
+
+    /**
+     * The models queued which aren't resident yet.
+     */
+    size_t pending() const;
+
+    void close();
+
+private:
+    struct load_job {
+        std::string path;
+        int hueVariants;
+        std::shared_ptr<model_assets> target;
+    };
+
+    // how far the model at the front of the uploads has got
+    struct upload_progress {
+        pool_range range{};
+        size_t part = 0; // the vertices, then the indices, then each image in turn
+        size_t done = 0; // the bytes of the part copied so far
+        material_textures textures;
+    };
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable wake; // signalled when a job is queued
+    std::deque<load_job> jobs;
+    std::deque<std::unique_ptr<decoded_model>> decoded; // finished by the workers, not yet picked up
+    size_t queued = 0; // the models loaded which aren't resident yet
+    bool stopping = false;
+
+    std::deque<std::unique_ptr<decoded_model>> uploads; // owned by the GL thread from here on
+    upload_progress progress;
+    GLuint stagingBuffer = 0;
+    std::vector<mesh_lod> placeholder;
+    GLsizei placeholderVertices = 0;
+
+    asset_loader();
+
+    void run();
+
+    size_t uploadPart(decoded_model &model, size_t budget);
+
+    void publish(decoded_model &model);
+};
@@ -8,6 +8,6 @@ static std::uniform_real_distribution<float> dist(0, 10);
 
 fish::fish(uint8_t group) {
     this->group = group;
-    this->hueShift = (float) (group % 5) / 5.0f;
+    this->hueShift = (float) (group % HUE_VARIANTS) / HUE_VARIANTS;
     this->timeOffset = dist(eng);
 }
\ No newline at end of file
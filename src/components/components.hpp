@@ -11,6 +11,8 @@
 #include "render.hpp"
 #include "../../lib/tiny_obj_loader.h"
 
+#define HUE_VARIANTS 5 // the number of distinct hues fish are drawn in
+
 /**
  * A marker for the fish population manager to show
  * that the entity is a fish managed by it.
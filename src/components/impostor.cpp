@@ -0,0 +1,145 @@
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "impostor.hpp"
+#include "../gl_state.hpp"
+
+/**
+ * Gets the direction at the centre of a view in the atlas,
+ * matching octDecode in vertex_fish_impostor.glsl.
+ */
+static glm::vec3 viewDirection(int x, int y) {
+    glm::vec2 p = (glm::vec2(x, y) + 0.5f) / (float) IMPOSTOR_GRID * 2.0f - 1.0f;
+    glm::vec3 d(p, 1.0f - std::abs(p.x) - std::abs(p.y));
+    if (d.z < 0.0f) {
+        glm::vec2 folded = 1.0f - glm::abs(glm::vec2(d.y, d.x));
+        d.x = folded.x * (d.x >= 0.0f ? 1.0f : -1.0f);
+        d.y = folded.y * (d.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(d);
+}
+
+static GLuint createAtlasTexture() {
+    const GLsizei size = IMPOSTOR_GRID * IMPOSTOR_TILE;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    gl_state::getInstance().bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, IMPOSTOR_PHASES, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    // views are a power of two in size, so the mip levels down to a pixel per view never mix them
+    int levels = 0;
+    while ((IMPOSTOR_TILE >> levels) > 1) levels++;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+impostor_atlas::impostor_atlas(renderable &model, shader bakeShader, float radius) : radius(radius) {
+    this->albedoTexture = createAtlasTexture();
+    this->normalTexture = createAtlasTexture();
+
+    // a single fish at the origin, facing forwards, with no time offset or hue shift
+    const float instance[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    const float attributes[2] = {0, 0};
+    GLuint instanceBuffer, attributeBuffer, attributeTexture;
+    glGenBuffers(1, &instanceBuffer);
+    gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(instance), instance, GL_STATIC_DRAW);
+    model.addVertexAttributeInstance(3, instanceBuffer, 4, GL_FLOAT, GL_FALSE, sizeof(instance), 0);
+    model.addVertexAttributeInstance(4, instanceBuffer, 4, GL_FLOAT, GL_FALSE, sizeof(instance), 4 * sizeof(float));
+
+    glGenBuffers(1, &attributeBuffer);
+    gl_state::getInstance().bindBuffer(GL_TEXTURE_BUFFER, attributeBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(attributes), attributes, GL_STATIC_DRAW);
+    glGenTextures(1, &attributeTexture);
+    gl_state::getInstance().bindTexture(UNIT_INSTANCE_ATTRIBUTES, GL_TEXTURE_BUFFER, attributeTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, attributeBuffer);
+
+    const GLsizei size = IMPOSTOR_GRID * IMPOSTOR_TILE;
+    GLuint framebuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // the bake fills its own frame block for each view, the frame rebinds the shared one afterwards
+    frame_uniform_buffer bakeFrame;
+    frame_uniforms frame = {};
+    bakeShader.use();
+    model.setTextures();
+
+    // an orthographic camera just containing the fish, looking at it from each view in turn
+    const glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 4.0f * radius);
+    for (int phase = 0; phase < IMPOSTOR_PHASES; phase++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, this->albedoTexture, 0, phase);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, this->normalTexture, 0, phase);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Couldn't create the framebuffer for baking impostors." << std::endl;
+            std::exit(1);
+        }
+
+        glViewport(0, 0, size, size);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        frame.time = phase * SWIM_PERIOD / IMPOSTOR_PHASES;
+
+        for (int y = 0; y < IMPOSTOR_GRID; y++) {
+            for (int x = 0; x < IMPOSTOR_GRID; x++) {
+                const glm::vec3 view = viewDirection(x, y);
+                const glm::mat4 camera = glm::lookAt(view * 2.0f * radius, glm::vec3(0), glm::vec3(0, 1, 0));
+                frame.view = camera;
+                frame.projection = projection;
+                frame.viewProjection = projection * camera;
+                frame.cameraPos = glm::vec4(view * 2.0f * radius, 1.0f);
+                bakeFrame.update(frame);
+                glViewport(x * IMPOSTOR_TILE, y * IMPOSTOR_TILE, IMPOSTOR_TILE, IMPOSTOR_TILE);
+                model.draw(1);
+            }
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    for (GLuint texture : {this->albedoTexture, this->normalTexture}) {
+        gl_state::getInstance().bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    gl_state::getInstance().deleteTexture(attributeTexture);
+    gl_state::getInstance().deleteBuffer(attributeBuffer);
+    gl_state::getInstance().deleteBuffer(instanceBuffer);
+    bakeFrame.close();
+    bakeShader.close();
+}
+
+void impostor_atlas::prepare(shader &impostorShader) {
+    gl_state::getInstance().bindTexture(UNIT_IMPOSTOR_ALBEDO, GL_TEXTURE_2D_ARRAY, this->albedoTexture);
+    gl_state::getInstance().bindTexture(UNIT_IMPOSTOR_NORMAL, GL_TEXTURE_2D_ARRAY, this->normalTexture);
+
+    impostorShader.setFloat("impostorRadius", this->radius);
+    impostorShader.setInteger("impostorGrid", IMPOSTOR_GRID);
+    impostorShader.setInteger("impostorPhases", IMPOSTOR_PHASES);
+    impostorShader.setFloat("impostorPeriod", SWIM_PERIOD);
+}
+
+void impostor_atlas::close() {
+    gl_state::getInstance().deleteTexture(this->albedoTexture);
+    gl_state::getInstance().deleteTexture(this->normalTexture);
+}
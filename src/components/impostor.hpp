@@ -0,0 +1,36 @@
+#pragma once
+
+#include "render.hpp"
+#include "swim_animation.hpp"
+
+#define IMPOSTOR_GRID 8 // the views along each side of the octahedral atlas
+#define IMPOSTOR_TILE 32 // the pixels along each side of a view
+#define IMPOSTOR_PHASES 16 // the frames baked of the swim cycle
+
+/**
+ * Pictures of the fish taken from directions spread evenly over an octahedron
+ * and unfolded into a square atlas, with a layer for each frame of the swim
+ * cycle. Far away fish are drawn as a single quad showing the closest view.
+ *
+ * The unlit albedo and the normals are baked, so the impostors are lit
+ * and hue shifted the same way as the fish themselves.
+ */
+class impostor_atlas {
+    GLuint albedoTexture; // a 2d array with a layer per frame
+    GLuint normalTexture;
+    float radius; // the half-size of the quad each view was baked into
+public:
+    /**
+     * Renders the model into the atlas.
+     * @param bakeShader The fish vertex shader with a fragment shader writing albedo and normals.
+     * @param radius The radius of the sphere the model stays inside while swimming.
+     */
+    impostor_atlas(renderable &model, shader bakeShader, float radius);
+
+    /**
+     * Binds the atlas to the impostor texture units and sets the uniforms describing it.
+     */
+    void prepare(shader &impostorShader);
+
+    void close();
+};
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
@@ -24,3 +26,25 @@ struct position {
 struct velocity {
     glm::vec3 velocity;
 };
+
+/**
+ * A compact alternative to position, used for fish when the compact
+ * storage setting is on. The position is 16-bit fixed point within
+ * the tank, and the orientation is smallest-three encoded in 64 bits.
+ */
+struct packed_position {
+    uint16_t x, y, z;
+    uint16_t padding;
+    uint64_t orientation;
+};
+
+/**
+ * A compact alternative to velocity, stored as half floats.
+ */
+struct packed_velocity {
+    uint16_t x, y, z;
+    uint16_t padding;
+};
+
+static_assert(sizeof(packed_position) == 16, "The simd kernels rely on the packed_position layout.");
+static_assert(sizeof(packed_velocity) == 8, "The simd kernels rely on the packed_velocity layout.");
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+/**
+ * The half-size of the cube, centred on the origin,
+ * which compact fish positions are quantized within.
+ */
+#define TANK_EXTENT 64.0f
+
+/**
+ * The instance slots the quantized instance format can address,
+ * as the slot goes through one of its 16-bit lanes.
+ */
+#define QUANTIZED_SLOTS 65536
+
+/**
+ * Quantizes a coordinate in [-extent, extent] to 16 bits, clamping it if outside.
+ */
+inline uint16_t quantizeAxis(float value, float extent) {
+    float unit = std::min(std::max((value + extent) / (2.0f * extent), 0.0f), 1.0f);
+    return (uint16_t) std::lround(unit * 65535.0f);
+}
+
+inline float dequantizeAxis(uint16_t value, float extent) {
+    return (float) value * (2.0f * extent / 65535.0f) - extent;
+}
+
+/**
+ * Packs a unit quaternion into 64 bits using smallest-three encoding.
+ *
+ * The largest component is dropped (and made positive by negating
+ * the quaternion, which represents the same rotation) and its index
+ * is stored in bits 60 and 61. The other three lie within
+ * [-1/sqrt(2), 1/sqrt(2)] and are stored in order in 20 bits each,
+ * from bit 40 down.
+ *
+ * Compact fish store their orientation like this between frames, so the
+ * step has to be finer than the smallest turn boids makes in a frame, or
+ * the turn rounds away and the fish stop short of their heading. At 20
+ * bits they get as close as they do in float.
+ */
+inline uint64_t packOrientation(float x, float y, float z, float w) {
+    const float q[4] = {x, y, z, w};
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; i++) {
+        if (std::fabs(q[i]) > std::fabs(q[largest])) largest = i;
+    }
+
+    float sign = q[largest] < 0 ? -1.0f : 1.0f;
+    uint64_t bits = (uint64_t) largest << 60u;
+    uint32_t shift = 40;
+    for (uint32_t i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        float unit = std::min(std::max(q[i] * sign * 1.41421356f * 0.5f + 0.5f, 0.0f), 1.0f);
+        bits |= (uint64_t) std::lround(unit * 1048575.0f) << shift;
+        shift -= 20;
+    }
+    return bits;
+}
+
+inline void unpackOrientation(uint64_t bits, float &x, float &y, float &z, float &w) {
+    float q[4];
+    auto largest = (uint32_t) (bits >> 60u);
+    uint32_t shift = 40;
+    float sum = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        q[i] = ((float) ((bits >> shift) & 0xfffffu) / 1048575.0f * 2.0f - 1.0f) / 1.41421356f;
+        sum += q[i] * q[i];
+        shift -= 20;
+    }
+    q[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    x = q[0];
+    y = q[1];
+    z = q[2];
+    w = q[3];
+}
+
+/**
+ * Converts a float to half precision, rounding to nearest even.
+ */
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    auto sign = (uint16_t) ((bits >> 16u) & 0x8000u);
+    uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x7f800000u) return sign | (magnitude > 0x7f800000u ? 0x7e00u : 0x7c00u); // nan or infinity
+    if (magnitude >= 0x477ff000u) return sign | 0x7c00u; // overflows to infinity
+    if (magnitude < 0x38800000u) {
+        // subnormal, let the fpu do the rounding
+        float f;
+        std::memcpy(&f, &magnitude, sizeof(f));
+        return sign | (uint16_t) std::lrint(f * 16777216.0f); // 2^24
+    }
+
+    uint32_t rounded = magnitude + 0xfffu + ((magnitude >> 13u) & 1u);
+    return sign | (uint16_t) ((rounded - 0x38000000u) >> 13u);
+}
+
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t) (half & 0x8000u) << 16u;
+    uint32_t exponent = (half >> 10u) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+
+    if (exponent == 0x1fu) {
+        uint32_t bits = sign | 0x7f800000u | (mantissa << 13u);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    // rebias the exponent by multiplying, which also normalizes subnormals
+    uint32_t bits = (uint32_t) (half & 0x7fffu) << 13u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    f *= 5.192296858534828e+33f; // 2^112
+    return sign ? -f : f;
+}
@@ -1,303 +1,166 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <random>
 #include <string>
 
-#define STB_IMAGE_IMPLEMENTATION
-
-#include <stb_image.h>
 #include <glad/glad.h>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "components.hpp"
 #include "render.hpp"
+#include "../asset_loader.hpp"
+#include "../gl_state.hpp"
+#include "../geometry_pool.hpp"
+#include "../shader_compiler.hpp"
 
 /**
- * Compiles the provided shader.
+ * Reads the source of a shader.
  *
  * @param shaderPath The path of the shader.
  * @param shaderType The type of shader.
- * @returns A unique ID for the compiled shader.
+ * @returns The stage, ready to compile.
  */
-GLuint compileShader(const std::string &shaderPath, const GLuint shaderType) {
-    GLuint shaderID = glCreateShader(shaderType);
-
-    std::string shaderCode;
+program_source readShader(const std::string &shaderPath, const GLenum shaderType) {
     std::ifstream shaderCodeStream(shaderPath, std::ios::in);
-    if (shaderCodeStream.is_open()) {
-        std::stringstream stringStream;
-        stringStream << shaderCodeStream.rdbuf();
-        shaderCode = stringStream.str();
-        shaderCodeStream.close();
-    } else {
+    if (!shaderCodeStream.is_open()) {
         throw "Couldn't read shader.";
     }
-
-    char const *sourcePointer = shaderCode.c_str();
-    glShaderSource(shaderID, 1, &sourcePointer, nullptr);
-    glCompileShader(shaderID);
-
-    GLint isCompiled = 0;
-    glGetShaderiv(shaderID, GL_COMPILE_STATUS, &isCompiled);
-    if (isCompiled == GL_FALSE) {
-        GLint maxLength = 0;
-        glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &maxLength);
-
-        std::cout << "Errors when compiling " << shaderPath << "." << std::endl;
-        std::vector<GLchar> errorLog(maxLength);
-        glGetShaderInfoLog(shaderID, maxLength, &maxLength, &errorLog[0]);
-        printf("%s\n", &errorLog[0]);
-        glDeleteShader(shaderID); // Don't leak the shader.
-        throw "Couldn't compile shader.";
-    }
-
-    return shaderID;
+    std::stringstream stringStream;
+    stringStream << shaderCodeStream.rdbuf();
+    shaderCodeStream.close();
+    return {shaderType, shaderPath, stringStream.str()};
 }
 
-/**
- * Given a vertex shader and fragment shader, creates a new shader program.
- * @returns A unique ID for the linked program.
- * @note The provided vertex shader and fragment shader are deleted.
- */
-GLuint linkProgram(const GLuint vertexShaderID, const GLuint fragmentShaderID) {
-    GLuint programID = glCreateProgram();
-    GLint status;
-
-    for (auto shaderID : {vertexShaderID, fragmentShaderID}) {
-        glAttachShader(programID, shaderID);
-    }
+renderable::renderable(const std::string &model, shader renderShader, int hueVariants)
+        : assets(std::make_shared<model_assets>()), renderShader(renderShader) {
+    // the pool's buffers keep their names as it grows, so the vertex array is set up before anything's in it
+    glGenVertexArrays(1, &this->vertexArrayID);
+    geometry_pool::getInstance().setVertexFormat(this->vertexArrayID);
 
-    glLinkProgram(programID);
-    glGetProgramiv(programID, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE) {
-        int length = 0;
-        glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &length);
-        if (length > 0) {
-            GLchar infoLog[512];
-            glGetProgramInfoLog(programID, 512, nullptr, infoLog);
-            std::cerr << infoLog;
-        }
-        std::exit(1);
-    }
-
-    for (auto shaderID : {vertexShaderID, fragmentShaderID}) {
-        glDetachShader(programID, shaderID);
-        glDeleteShader(shaderID);
-    }
-
-    return programID;
+    asset_loader &loader = asset_loader::getInstance();
+    loader.usePlaceholder(*this->assets);
+    loader.load(model, hueVariants, this->assets);
 }
 
-/**
- * Initializes a triangle into the given vertex buffer and array.
- *
- * Creates a buffer and sets vertexBufferID to the new value.
- * Selects the buffer and loads the vertices into it.
- *
- * @param vertexBufferID
- * @param vertexArrayID
- * @param triangles A pointer to place the number of triangles into.
- */
-bool
-loadGeometry(const tinyobj::ObjReader &reader, GLuint &vertexBufferID, GLuint &vertexArrayID, GLsizei &triangles) {
-    // only support triangles
-    const uint8_t faceSides = 3;
-
-    triangles = 0;
-    for (const auto &shape : reader.GetShapes()) {
-        triangles += (GLsizei) shape.mesh.num_face_vertices.size();
-        for (auto vert : shape.mesh.num_face_vertices) {
-            if (vert != faceSides) return false;
-        }
-    }
-
-    std::vector<tinyobj::real_t> vec;
-    auto vertices = reader.GetAttrib().vertices;
-    auto normals = reader.GetAttrib().normals;
-    auto texcoords = reader.GetAttrib().texcoords;
-    for (const auto &shape : reader.GetShapes()) {
-        for (auto index : shape.mesh.indices) {
-            for (int i = 0; i < faceSides; i++) vec.push_back(vertices[index.vertex_index * 3 + i]);
-            for (int i = 0; i < faceSides; i++) vec.push_back(normals[index.normal_index * 3 + i]);
-
-            //texture coordinates with inverted Y
-            vec.push_back(texcoords[index.texcoord_index * 2]);
-            vec.push_back(1.0f - texcoords[index.texcoord_index * 2 + 1]);
-        }
-    }
-
-    glGenBuffers(1, &vertexBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(tinyobj::real_t) * vec.size(), &vec.at(0), GL_STATIC_DRAW);
-
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (3 + 3 + 2) * sizeof(float), (void *) (0 * 3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, (3 + 3 + 2) * sizeof(float), (void *) (1 * 3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, (3 + 3 + 2) * sizeof(float), (void *) (2 * 3 * sizeof(float)));
-
+bool renderable::prepare() {
+    if (!this->renderShader.ready()) return false;
+    this->renderShader.use();
+    this->setTextures();
     return true;
 }
 
-GLuint loadTexture(const std::string &file) {
-    GLuint texture_id;
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int components;
-    int image_width, image_height;
-    uint8_t *image = stbi_load(file.c_str(), &image_width, &image_height, &components, STBI_default);
-    if (!image) {
-        std::cerr << "Unable to load texture: " << file << std::endl;
-        exit(1);
-    } else {
-        std::cout << "Loaded texture " << texture_id << ": " << file << std::endl;
-    }
-
-    if (components == 3)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    else if (components == 4)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    else {
-        std::cerr << "Unable to load texture with " << components << " components: " << file << std::endl;
-        exit(1);
-    }
-
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(image);
-    return texture_id;
+bool renderable::resident() const {
+    return this->assets->resident;
 }
 
-/**
- * Loads textures from a tinyobj reader, storing their texture name and ID in a map.
- *
- * todo(arlyon) only supports one material (the first)
- * todo(arlyon) only supports loading some well-defined textures
- */
-bool loadTextures(const tinyobj::ObjReader &reader, material_textures &textures) {
-    auto material = reader.GetMaterials()[0];
-
-    if (material.diffuse_texname.empty()) textures.diffuse = {};
-    else textures.diffuse = {loadTexture(material.diffuse_texname)};
-    if (material.roughness_texname.empty()) textures.roughness = {};
-    else textures.roughness = {loadTexture(material.roughness_texname)};
-    if (material.metallic_texname.empty()) textures.metallic = {};
-    else textures.metallic = {loadTexture(material.metallic_texname)};
-
-    return true;
+float renderable::getBoundingRadius() const {
+    return this->assets->boundingRadius;
 }
 
-renderable::renderable(const std::string &model, shader renderShader) : renderShader(renderShader) {
-    auto reader = tinyobj::ObjReader{};
-    if (!reader.ParseFromFile(model)) {
-        std::cerr << "Couldn't load file " << model << "." << std::endl;
-        std::exit(1);
-    }
-
-    if (!loadGeometry(reader, this->vertexBufferID, this->vertexArrayID, this->triangles)) {
-        std::cerr << "Error parsing geometry for " << model << ". Are you only using triangles?" << std::endl;
-        std::exit(1);
-    }
+const material_textures &renderable::getTextures() const {
+    return this->assets->textures;
+}
 
-    if (!loadTextures(reader, this->textures)) {
-        std::cerr << "Error loading textures for " << model << "." << std::endl;
-        std::exit(1);
-    }
+const shader &renderable::getShader() const {
+    return this->renderShader;
 }
 
-void
-renderable::render(position objPos, position camPos, const glm::mat4 &projectionMatrix, const glm::mat4 &viewMatrix,
-                   double time) {
-    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), objPos.position) * glm::mat4_cast(objPos.orientation);
-    glm::mat4 mvp = projectionMatrix * viewMatrix * modelMatrix;
+std::vector<float> renderable::readVertices() const {
+    return geometry_pool::getInstance().read(this->assets->lods.front().baseVertex, this->assets->vertexCount);
+}
 
-    this->renderShader.use();
-    this->renderShader.setFloat("time", (float) time);
-    this->renderShader.setMatrix("mvp", mvp);
-    this->renderShader.setVector("cameraPos", camPos.position);
-    this->renderShader.prepareTextures();
-    this->setTextures();
-    this->draw();
+const mesh_lod &renderable::getLod(size_t lod) const {
+    return this->assets->lods[std::min(lod, this->assets->lods.size() - 1)];
+}
 
-    glUseProgram(0);
+size_t renderable::getLodCount() const {
+    return this->assets->lods.size();
 }
 
-void renderable::draw(size_t count) {
-    glBindVertexArray(this->vertexArrayID);
+void renderable::draw(size_t count, size_t lod) {
+    const mesh_lod &range = this->getLod(lod);
+    gl_state::getInstance().bindVertexArray(this->vertexArrayID);
+    // see https://stackoverflow.com/a/26283148/4913983
+    GLvoid const *indices = static_cast<char const *>(0) + range.firstIndex * sizeof(uint32_t);
     if (count == 1) {
-        glDrawArrays(GL_TRIANGLES, 0, this->triangles * 3);
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indices, GL_UNSIGNED_INT, indices, range.baseVertex);
     } else if (count > 1) {
-        glDrawArraysInstanced(GL_TRIANGLES, 0, this->triangles * 3, (GLsizei)count);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indices, GL_UNSIGNED_INT, indices, (GLsizei) count,
+                                          range.baseVertex);
     }
-    glBindVertexArray(0);
+}
+
+void renderable::drawIndirect(GLuint commandBuffer, size_t command) {
+    gl_state &state = gl_state::getInstance();
+    state.bindVertexArray(this->vertexArrayID);
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    // see https://stackoverflow.com/a/26283148/4913983
+    GLvoid const *pointer = static_cast<char const *>(0) + command * 5 * sizeof(GLuint);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, pointer);
 }
 
 void renderable::close() {
-    glDeleteBuffers(1, &this->vertexBufferID);
-    glDeleteVertexArrays(1, &this->vertexArrayID);
+    gl_state::getInstance().deleteVertexArray(this->vertexArrayID);
     this->renderShader.close();
 }
 
 void renderable::setTextures() {
+    const material_textures &textures = this->assets->textures;
     if (textures.diffuse) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, *textures.diffuse);
+        gl_state::getInstance().bindTexture(UNIT_DIFFUSE, GL_TEXTURE_2D, *textures.diffuse);
     }
 
     if (textures.roughness) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, *textures.roughness);
+        gl_state::getInstance().bindTexture(UNIT_ROUGHNESS, GL_TEXTURE_2D, *textures.roughness);
     }
 
     if (textures.metallic) {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, *textures.metallic);
+        gl_state::getInstance().bindTexture(UNIT_METALLIC, GL_TEXTURE_2D, *textures.metallic);
     }
-}
-
-void renderable::addVertexAttributeMatrix(GLuint index, GLuint bufferID) {
-    glBindVertexArray(this->vertexArrayID);
-    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-    GLsizei vec4Size = sizeof(glm::vec4);
-    for (auto x : {0, 1, 2, 3}) {
-		// see https://stackoverflow.com/a/26283148/4913983
-		GLvoid const* pointer = static_cast<char const*>(0) + x * vec4Size;
 
-        glEnableVertexAttribArray(index + x);
-        glVertexAttribPointer(index + x, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, pointer);
-        glVertexAttribDivisor(index + x, 1);
+    if (textures.diffuseHues) {
+        gl_state::getInstance().bindTexture(UNIT_DIFFUSE_HUES, GL_TEXTURE_2D_ARRAY, *textures.diffuseHues);
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
 }
 
-void renderable::addVertexAttributeFloat(GLuint index, GLuint bufferID) {
-    glBindVertexArray(this->vertexArrayID);
-    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+void renderable::addVertexAttributeInstance(GLuint index, GLuint bufferID, GLint size, GLenum type,
+                                            GLboolean normalized, GLsizei stride, size_t offset) {
+    gl_state::getInstance().bindVertexArray(this->vertexArrayID);
+    gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, bufferID);
+    // see https://stackoverflow.com/a/26283148/4913983
+    GLvoid const* pointer = static_cast<char const*>(0) + offset;
+
     glEnableVertexAttribArray(index);
-    glVertexAttribPointer(index, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
     glVertexAttribDivisor(index, 1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
 }
 
 shader::shader(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) {
     try {
-        GLuint vertexShaderID = compileShader(vertexShaderPath, GL_VERTEX_SHADER);
-        GLuint fragmentShaderID = compileShader(fragmentShaderPath, GL_FRAGMENT_SHADER);
-        this->shaderProgramID = linkProgram(vertexShaderID, fragmentShaderID);
+        this->program = shader_compiler::getInstance().compile({readShader(vertexShaderPath, GL_VERTEX_SHADER),
+                                                                readShader(fragmentShaderPath, GL_FRAGMENT_SHADER)});
+    }
+    catch (const char *error) {
+        std::cerr << error << std::endl;
+        std::exit(1);
+    }
+}
+
+shader::shader(const std::string &computeShaderPath, const std::vector<std::pair<std::string, long>> &defines) {
+    try {
+        program_source stage = readShader(computeShaderPath, GL_COMPUTE_SHADER);
+        std::string lines;
+        for (const auto &define : defines) lines += "#define " + define.first + " " + std::to_string(define.second) + "\n";
+
+        // the defines have to come after the #version line, which must be the first thing in the source
+        const size_t version = stage.code.find("#version");
+        const size_t line = version == std::string::npos ? std::string::npos : stage.code.find('\n', version);
+        stage.code.insert(line == std::string::npos ? 0 : line + 1, lines);
+        this->program = shader_compiler::getInstance().compile({stage});
     }
     catch (const char *error) {
         std::cerr << error << std::endl;
@@ -305,32 +168,73 @@ shader::shader(const std::string &vertexShaderPath, const std::string &fragmentS
     }
 }
 
+bool shader::ready() const {
+    return this->program->linked;
+}
+
+GLint shader::location(const std::string &name) const {
+    auto found = this->program->uniforms.find(name);
+    return found == this->program->uniforms.end() ? -1 : found->second;
+}
+
 void shader::use() {
-    glUseProgram(this->shaderProgramID);
+    gl_state::getInstance().useProgram(this->program->id);
+}
+
+GLuint shader::id() const {
+    return this->program->id;
 }
 
 void shader::setMatrix(const std::string &name, glm::mat4 matrix) {
-    glUniformMatrix4fv(glGetUniformLocation(this->shaderProgramID, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void shader::setInteger(const std::string &name, int i) {
-    glUniform1i(glGetUniformLocation(this->shaderProgramID, name.c_str()), i);
+    glUniform1i(location(name), i);
 }
 
 void shader::setFloat(const std::string &name, float f) {
-    glUniform1f(glGetUniformLocation(this->shaderProgramID, name.c_str()), f);
+    glUniform1f(location(name), f);
 }
 
 void shader::setVector(const std::string &name, glm::vec3 vector) {
-    glUniform3fv(glGetUniformLocation(this->shaderProgramID, name.c_str()), 1, glm::value_ptr(vector));
+    glUniform3fv(location(name), 1, glm::value_ptr(vector));
+}
+
+void shader::setVector2(const std::string &name, glm::vec2 vector) {
+    glUniform2fv(location(name), 1, glm::value_ptr(vector));
 }
 
-void shader::prepareTextures() {
-    setInteger("diffuse", 0);
-    setInteger("roughness", 1);
-    setInteger("metallic", 2);
+void shader::setVector4(const std::string &name, glm::vec4 vector) {
+    glUniform4fv(location(name), 1, glm::value_ptr(vector));
+}
+
+void shader::setVector4Array(const std::string &name, const glm::vec4 *vectors, size_t count) {
+    glUniform4fv(location(name), (GLsizei) count, glm::value_ptr(*vectors));
+}
+
+void shader::setFloatArray(const std::string &name, const float *floats, size_t count) {
+    glUniform1fv(location(name), (GLsizei) count, floats);
 }
 
 void shader::close() {
-    glDeleteProgram(shaderProgramID);
+    gl_state::getInstance().deleteProgram(this->program->id);
+}
+
+frame_uniform_buffer::frame_uniform_buffer() {
+    glGenBuffers(1, &this->bufferID);
+    gl_state::getInstance().bindBuffer(GL_UNIFORM_BUFFER, this->bufferID);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_uniforms), nullptr, GL_STREAM_DRAW);
+}
+
+void frame_uniform_buffer::update(const frame_uniforms &uniforms) {
+    // respecifying the whole buffer lets the driver hand back fresh storage
+    // rather than waiting for last frame's draws to finish with it
+    gl_state::getInstance().bindBuffer(GL_UNIFORM_BUFFER, this->bufferID);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_uniforms), &uniforms, GL_STREAM_DRAW);
+    gl_state::getInstance().bindUniformBuffer(FRAME_UNIFORM_BINDING, this->bufferID);
+}
+
+void frame_uniform_buffer::close() {
+    gl_state::getInstance().deleteBuffer(this->bufferID);
 }
@@ -4,24 +4,145 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "physics.hpp"
+#include "../mesh/bake.hpp"
 
 struct material_textures {
     std::optional<GLuint> diffuse;
     std::optional<GLuint> roughness;
     std::optional<GLuint> metallic;
+    std::optional<GLuint> diffuseHues; // the diffuse texture in an array of hue shifted layers
 };
 
+/**
+ * The cached world matrix of a renderable, along with the
+ * position it was built from. It is only rebuilt by the
+ * transform system when the entity's position changes.
+ */
+struct world_transform {
+    position source;
+    glm::mat4 matrix;
+};
+
+/**
+ * A range of indices in the geometry pool for one level of detail,
+ * which count from the model's first vertex.
+ */
+struct mesh_lod {
+    GLuint firstIndex;
+    GLsizei indices;
+    GLint baseVertex; // the model's first vertex in the pool
+};
+
+/**
+ * The parts of a model which arrive once it has loaded, shared between
+ * the copies of its renderable so they all see it become resident.
+ * Until then it is drawn as the asset loader's placeholder.
+ */
+struct model_assets {
+    std::vector<mesh_lod> lods; // the full model first, then simpler versions, as ranges of the geometry pool
+    GLsizei vertexCount = 0; // the vertices of every level of detail together
+    float boundingRadius = 0.0f; // the radius of a sphere about the origin containing the model
+    material_textures textures; // the textures when rendering this model
+    bool resident = false;
+};
+
+/**
+ * A model registered with the render queue, which entities refer
+ * to by index rather than each holding a copy of the renderable.
+ */
+struct model_handle {
+    uint32_t index;
+};
+
+/**
+ * The slot of an instanced entity in the static instance
+ * attribute buffer, which it keeps for as long as it lives.
+ */
+struct instance_slot {
+    uint32_t index;
+};
+
+
+// the texture unit each sampler reads from, assigned to every program once when it's linked
+#define UNIT_DIFFUSE 0
+#define UNIT_ROUGHNESS 1
+#define UNIT_METALLIC 2
+#define UNIT_INSTANCE_ATTRIBUTES 3
+#define UNIT_IMPOSTOR_ALBEDO 4
+#define UNIT_IMPOSTOR_NORMAL 5
+#define UNIT_SWIM_ANIMATION 6
+#define UNIT_DIFFUSE_HUES 7
+
+#define FRAME_UNIFORM_BINDING 0 // the uniform buffer binding of the frame_data block
+
+/**
+ * The uniforms which are the same for every program over a frame,
+ * laid out to match the std140 frame_data block in the shaders.
+ */
+struct frame_uniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPos;
+    glm::vec4 fogColor;
+    glm::vec4 backgroundColor;
+    float time;
+    int32_t bpm;
+    float padding[2];
+};
+
+static_assert(sizeof(frame_uniforms) == 256, "frame_uniforms must match the std140 layout of frame_data");
+
+/**
+ * The uniform buffer holding the frame_data block, written once
+ * per frame and shared by every program through its binding.
+ */
+class frame_uniform_buffer {
+    GLuint bufferID;
+public:
+    frame_uniform_buffer();
 
+    void update(const frame_uniforms &uniforms);
+
+    void close();
+};
+
+struct compiled_program;
+
+/**
+ * A shader program, compiled in the background by the shader_compiler.
+ */
 class shader {
-    GLuint shaderProgramID; // the program to use when rendering this model
+    std::shared_ptr<compiled_program> program; // the program to use when rendering this model
+
+    GLint location(const std::string &name) const;
 public:
     shader(const std::string &vertexShaderPath, const std::string &fragmentShaderPath);
 
+    /**
+     * Makes a compute shader.
+     * @param defines Names and values defined just after the #version line, so constants can come from the cpu side.
+     */
+    explicit shader(const std::string &computeShaderPath, const std::vector<std::pair<std::string, long>> &defines = {});
+
+    /**
+     * Whether the program has linked and its uniforms have been looked up.
+     * Nothing should be drawn with it until it is ready.
+     */
+    bool ready() const;
+
     void use();
 
+    GLuint id() const;
+
     void setMatrix(const std::string &name, glm::mat4 matrix);
 
     void setFloat(const std::string &name, float f);
@@ -30,41 +151,84 @@ public:
 
     void setVector(const std::string &name, glm::vec3 vector);
 
+    void setVector2(const std::string &name, glm::vec2 vector);
+
+    void setVector4(const std::string &name, glm::vec4 vector);
+
+    void setVector4Array(const std::string &name, const glm::vec4 *vectors, size_t count);
+
+    void setFloatArray(const std::string &name, const float *floats, size_t count);
+
     void loadTextures(material_textures textures);
 
     void close();
-
-    void prepareTextures();
 };
 
 /**
  * A model to be rendered by OpenGL
  */
 class renderable {
-    GLuint vertexBufferID; // the vertex buffer for this model
-    GLuint vertexArrayID; // the vertex array for this model
-    GLsizei triangles; // the number of triangles
-    material_textures textures; // the textures when rendering this model
+    GLuint vertexArrayID; // the vertex array for this model, over the geometry pool
+    std::shared_ptr<model_assets> assets; // filled in by the asset loader, shared between copies
     shader renderShader;
 public:
     /**
     * Creates a renderable from a given obj, vertex shader, and fragment shader.
+    * The model and its textures are loaded in the background, and it is drawn
+    * as a placeholder until they are resident.
     * @param model The path to the model to use the renderable with.
     * @param vertex The path to the vertex shader to use.
     * @param fragment The path to the fragment shader to use.
+    * @param hueVariants The number of hue shifted copies of the diffuse texture to make, if any.
     * @return A renderable.
     */
-    renderable(const std::string &model, shader shader);
+    renderable(const std::string &model, shader shader, int hueVariants = 0);
+
+    /**
+     * Binds a per-instance attribute of the given layout to this model's vertex array.
+     * @param offset The byte offset of the attribute within each instance record.
+     */
+    void addVertexAttributeInstance(GLuint index, GLuint bufferID, GLint size, GLenum type, GLboolean normalized,
+                                    GLsizei stride, size_t offset);
+
+    /**
+     * Uses the shader and binds the textures for drawing this model.
+     * @returns Whether the shader is ready, if it isn't the model can't be drawn yet.
+     */
+    bool prepare();
+
+    /**
+     * Whether the model's own geometry and textures have been uploaded, rather than the placeholder's.
+     */
+    bool resident() const;
+
+    float getBoundingRadius() const;
 
-    void addVertexAttributeMatrix(GLuint index, GLuint bufferID);
+    /**
+     * The range of the geometry pool holding a level of detail, or the simplest if there are fewer.
+     */
+    const mesh_lod &getLod(size_t lod = 0) const;
 
-    void addVertexAttributeFloat(GLuint index, GLuint bufferID);
+    const material_textures &getTextures() const;
 
-    void render(position objPos, position camPos, const glm::mat4 &projectionMatrix, const glm::mat4 &viewMatrix, double time);
+    const shader &getShader() const;
 
     void setTextures();
 
-    void draw(size_t count = 1);
+    size_t getLodCount() const;
+
+    /**
+     * Reads back the model's vertices, every level of detail after the
+     * other, laid out as VERTEX_FLOATS floats per vertex.
+     */
+    std::vector<float> readVertices() const;
+
+    void draw(size_t count = 1, size_t lod = 0);
+
+    /**
+     * Draws with the DrawElementsIndirectCommand at the given index of a buffer.
+     */
+    void drawIndirect(GLuint commandBuffer, size_t command);
 
     void close();
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "swim_animation.hpp"
+#include "../mesh/simplify.hpp"
+#include "../gl_state.hpp"
+
+// matches the approximation used by the shader, so the baked frames line up with it
+#define SHADER_PI 3.14f
+
+/**
+ * Moves a vertex the same way as main in vertex_fish.glsl:
+ * swim, then twist, then yaw, then translate.
+ */
+static glm::vec3 swimVertex(glm::vec3 v, float time) {
+    const float wave = time * SHADER_PI * 2;
+
+    // swim
+    float a = glm::smoothstep(-1.5f, 5.0f, v.z) * std::sin(v.z + wave) * 0.6f;
+    v = glm::vec3(v.x * std::cos(a) - v.z * std::sin(a), v.y, v.x * std::sin(a) + v.z * std::cos(a));
+
+    // twist
+    a = glm::smoothstep(-3.0f, 8.0f, v.z) * std::sin(v.z + wave) * 0.8f;
+    v = glm::vec3(v.x * std::cos(a) - v.y * std::sin(a), v.x * std::sin(a) + v.y * std::cos(a), v.z);
+
+    // yaw
+    a = std::sin(wave) * 0.1f;
+    v = glm::vec3(v.x * std::cos(a) - v.z * std::sin(a), v.y, v.x * std::sin(a) + v.z * std::cos(a));
+
+    // translate
+    const float loc = std::sin(time * (3 * SHADER_PI) / 2) * 0.3f;
+    v.x += std::pow(std::abs(loc), 0.77f) / 6 * (loc > 0.0f ? 1.0f : loc < 0.0f ? -1.0f : 0.0f);
+    return v;
+}
+
+swim_animation::swim_animation(renderable &model) : baseVertex(model.getLod(0).baseVertex) {
+    const std::vector<float> vertices = model.readVertices();
+    const size_t vertexCount = vertices.size() / VERTEX_FLOATS;
+
+    // a model with more vertices than fit across the texture wraps them onto more rows of each frame
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    this->width = (GLint) std::max<size_t>(std::min(vertexCount, (size_t) maxSize), 1);
+    this->rows = (GLint) ((vertexCount + (size_t) this->width - 1) / (size_t) this->width);
+    if ((size_t) this->rows * SWIM_FRAMES > (size_t) maxSize) {
+        std::cerr << "The model has too many vertices to bake its swim cycle, so it will be worked out per vertex."
+                  << std::endl;
+        return;
+    }
+
+    const size_t frameTexels = (size_t) this->width * (size_t) this->rows;
+    std::vector<glm::vec4> frames(frameTexels * SWIM_FRAMES);
+    for (size_t frame = 0; frame < SWIM_FRAMES; frame++) {
+        const float time = frame * SWIM_PERIOD / SWIM_FRAMES;
+        for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+            const float *p = &vertices[vertex * VERTEX_FLOATS];
+            frames[frame * frameTexels + vertex] = glm::vec4(swimVertex(glm::vec3(p[0], p[1], p[2]), time), 1.0f);
+        }
+    }
+
+    // half floats are plenty for a model a few units across
+    glGenTextures(1, &this->texture);
+    gl_state::getInstance().bindTexture(GL_TEXTURE_2D, this->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, this->width, this->rows * SWIM_FRAMES, 0, GL_RGBA, GL_FLOAT, frames.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+void swim_animation::prepare(shader &fishShader) {
+    gl_state::getInstance().bindTexture(UNIT_SWIM_ANIMATION, GL_TEXTURE_2D, this->texture);
+
+    fishShader.setInteger("swimFrames", SWIM_FRAMES);
+    fishShader.setFloat("swimPeriod", SWIM_PERIOD);
+    fishShader.setInteger("swimBaseVertex", this->baseVertex);
+    fishShader.setInteger("swimWidth", this->width);
+    fishShader.setInteger("swimRows", this->rows);
+}
+
+bool swim_animation::baked() const {
+    return this->texture != 0;
+}
+
+void swim_animation::close() {
+    gl_state::getInstance().deleteTexture(this->texture);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "render.hpp"
+
+#define SWIM_FRAMES 32 // the frames baked of the swim cycle
+#define SWIM_PERIOD 4.0f // the seconds after which every part of the swim cycle repeats
+
+/**
+ * The swim cycle from vertex_fish.glsl, evaluated for every vertex of a
+ * model and stored in a texture with a band of rows per frame. Fish using
+ * it do a pair of fetches per vertex rather than the trigonometry.
+ */
+class swim_animation {
+    GLuint texture = 0;
+    GLint baseVertex; // the model's first vertex in the geometry pool
+    GLint width; // the vertices in each row, those past it wrap onto the next
+    GLint rows; // the rows each frame takes up
+public:
+    /**
+     * Bakes the animation for every vertex of the model, at every level of detail.
+     */
+    explicit swim_animation(renderable &model);
+
+    /**
+     * Whether the animation fit in a texture, if not the fish have to work it out per vertex.
+     */
+    bool baked() const;
+
+    /**
+     * Binds the texture to its unit and sets the uniforms describing it.
+     */
+    void prepare(shader &fishShader);
+
+    void close();
+};
@@ -0,0 +1,114 @@
+#include <stddef.h>
+
+#include "geometry_pool.hpp"
+#include "gl_state.hpp"
+#include "mesh/simplify.hpp"
+
+/**
+ * Respecifies a buffer with more room, keeping the bytes already in it. They are
+ * parked in a scratch buffer meanwhile, as respecifying the storage throws it away,
+ * but keeps the name the vertex arrays point at. The copy targets are used
+ * throughout so the element array of whichever vertex array is bound is untouched.
+ */
+static void growBuffer(GLuint buffer, size_t used, size_t size) {
+    gl_state &state = gl_state::getInstance();
+    GLuint scratch = 0;
+    if (used > 0) {
+        glGenBuffers(1, &scratch);
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+        glBufferData(GL_COPY_WRITE_BUFFER, used, nullptr, GL_STREAM_COPY);
+        state.bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    }
+
+    state.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+
+    if (scratch) {
+        state.bindBuffer(GL_COPY_READ_BUFFER, scratch);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        state.deleteBuffer(scratch);
+    }
+}
+
+geometry_pool::geometry_pool() {
+    glGenBuffers(1, &this->vertexBufferID);
+    glGenBuffers(1, &this->indexBufferID);
+    growBuffer(this->vertexBufferID, 0, GEOMETRY_POOL_VERTICES * sizeof(packed_vertex));
+    growBuffer(this->indexBufferID, 0, GEOMETRY_POOL_INDICES * sizeof(uint32_t));
+    this->vertexCapacity = GEOMETRY_POOL_VERTICES;
+    this->indexCapacity = GEOMETRY_POOL_INDICES;
+}
+
+pool_range geometry_pool::allocate(const packed_vertex *vertices, size_t vertexCount,
+                                   const uint32_t *indices, size_t indexCount) {
+    const pool_range range = this->reserve(vertexCount, indexCount);
+    this->writeVertices(range.baseVertex, vertices, vertexCount);
+    this->writeIndices(range.firstIndex, indices, indexCount);
+    return range;
+}
+
+pool_range geometry_pool::reserve(size_t vertexCount, size_t indexCount) {
+    if (this->verticesUsed + vertexCount > this->vertexCapacity) {
+        size_t capacity = this->vertexCapacity;
+        while (capacity < this->verticesUsed + vertexCount) capacity *= 2;
+        growBuffer(this->vertexBufferID, this->verticesUsed * sizeof(packed_vertex), capacity * sizeof(packed_vertex));
+        this->vertexCapacity = capacity;
+    }
+    if (this->indicesUsed + indexCount > this->indexCapacity) {
+        size_t capacity = this->indexCapacity;
+        while (capacity < this->indicesUsed + indexCount) capacity *= 2;
+        growBuffer(this->indexBufferID, this->indicesUsed * sizeof(uint32_t), capacity * sizeof(uint32_t));
+        this->indexCapacity = capacity;
+    }
+
+    const pool_range range = {(GLint) this->verticesUsed, (GLuint) this->indicesUsed};
+    this->verticesUsed += vertexCount;
+    this->indicesUsed += indexCount;
+    return range;
+}
+
+void geometry_pool::writeVertices(GLint first, const packed_vertex *vertices, size_t count) {
+    gl_state::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, this->vertexBufferID);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first * sizeof(packed_vertex), count * sizeof(packed_vertex), vertices);
+}
+
+void geometry_pool::writeIndices(GLuint first, const uint32_t *indices, size_t count) {
+    gl_state::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, this->indexBufferID);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first * sizeof(uint32_t), count * sizeof(uint32_t), indices);
+}
+
+std::vector<float> geometry_pool::read(GLint first, GLsizei count) const {
+    std::vector<packed_vertex> packed((size_t) count);
+    gl_state::getInstance().bindBuffer(GL_COPY_READ_BUFFER, this->vertexBufferID);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, first * sizeof(packed_vertex), count * sizeof(packed_vertex), packed.data());
+
+    std::vector<float> vertices(packed.size() * VERTEX_FLOATS);
+    for (size_t vertex = 0; vertex < packed.size(); vertex++) unpackVertex(packed[vertex], &vertices[vertex * VERTEX_FLOATS]);
+    return vertices;
+}
+
+void geometry_pool::setVertexFormat(GLuint vertexArray) const {
+    gl_state &state = gl_state::getInstance();
+    state.bindVertexArray(vertexArray);
+    state.bindBuffer(GL_ARRAY_BUFFER, this->vertexBufferID);
+    // the element array belongs to the vertex array, so it isn't cached
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBufferID);
+
+    const auto stride = (GLsizei) sizeof(packed_vertex);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void *) offsetof(packed_vertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *) offsetof(packed_vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *) offsetof(packed_vertex, texcoord));
+}
+
+GLuint geometry_pool::id() const {
+    return this->vertexBufferID;
+}
+
+void geometry_pool::close() {
+    gl_state::getInstance().deleteBuffer(this->vertexBufferID);
+    gl_state::getInstance().deleteBuffer(this->indexBufferID);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+
+#include "mesh/pack.hpp"
+
+#define GEOMETRY_POOL_VERTICES 65536 // the vertices the pool has room for before it first grows
+#define GEOMETRY_POOL_INDICES (GEOMETRY_POOL_VERTICES * 3) // the indices the pool has room for before it first grows
+
+/**
+ * Where a model's vertices and indices landed in the pool.
+ */
+struct pool_range {
+    GLint baseVertex; // the vertex the model's indices count from
+    GLuint firstIndex;
+};
+
+/**
+ * A single vertex buffer and index buffer which every model's geometry
+ * is allocated from, in one vertex format, so models can be drawn from
+ * one vertex array and merged into one multi-draw.
+ *
+ * Vertices are stored as packed_vertex, 16 bytes each.
+ *
+ * The buffers keep their names when they grow, so vertex arrays
+ * pointed at them stay valid.
+ */
+class geometry_pool {
+public:
+    static geometry_pool &getInstance() {
+        static geometry_pool instance;
+        return instance;
+    }
+
+    geometry_pool(geometry_pool const &) = delete;
+
+    void operator=(geometry_pool const &) = delete;
+
+    /**
+     * Copies packed vertices into the pool, and their indices after those already in it.
+     */
+    pool_range allocate(const packed_vertex *vertices, size_t vertexCount, const uint32_t *indices, size_t indexCount);
+
+    /**
+     * Sets aside room for a model after those already in the pool, growing it
+     * if needed, to be filled in piece by piece with writeVertices and writeIndices.
+     */
+    pool_range reserve(size_t vertexCount, size_t indexCount);
+
+    /**
+     * Copies packed vertices into the pool from the given vertex on.
+     */
+    void writeVertices(GLint first, const packed_vertex *vertices, size_t count);
+
+    /**
+     * Copies indices into the pool from the given index on.
+     */
+    void writeIndices(GLuint first, const uint32_t *indices, size_t count);
+
+    /**
+     * Reads back and unpacks a range of vertices, laid out as VERTEX_FLOATS floats each.
+     */
+    std::vector<float> read(GLint first, GLsizei count) const;
+
+    /**
+     * Points the position, normal and texture coordinate attributes
+     * and the element array of a vertex array at the pool.
+     */
+    void setVertexFormat(GLuint vertexArray) const;
+
+    GLuint id() const;
+
+    void close();
+
+private:
+    GLuint vertexBufferID = 0;
+    GLuint indexBufferID = 0;
+    size_t vertexCapacity = 0;
+    size_t verticesUsed = 0;
+    size_t indexCapacity = 0;
+    size_t indicesUsed = 0;
+
+    geometry_pool();
+};
@@ -0,0 +1,125 @@
+#include <algorithm>
+
+#include "gl_state.hpp"
+
+gl_state::gl_state() {
+    this->invalidate();
+}
+
+/**
+ * Counts a bind, recording the new object if it differs from the bound one.
+ * @param bound Where the binding is tracked, or nullptr if it isn't.
+ * @returns Whether the bind has to be made.
+ */
+bool gl_state::changed(GLuint *bound, GLuint object) {
+    if (bound && *bound == object) {
+        this->current.skipped++;
+        return false;
+    }
+
+    if (bound) *bound = object;
+    this->current.issued++;
+    return true;
+}
+
+GLuint *gl_state::bufferBinding(GLenum target) {
+    auto found = std::find(bufferTargets.begin(), bufferTargets.end(), target);
+    return found == bufferTargets.end() ? nullptr : &this->buffers[found - bufferTargets.begin()];
+}
+
+GLuint *gl_state::textureBinding(GLuint unit, GLenum target) {
+    auto found = std::find(textureTargets.begin(), textureTargets.end(), target);
+    if (unit >= GL_STATE_TEXTURE_UNITS || found == textureTargets.end()) return nullptr;
+    return &this->textures[unit][found - textureTargets.begin()];
+}
+
+void gl_state::activateUnit(GLuint unit) {
+    if (this->changed(&this->activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void gl_state::useProgram(GLuint program) {
+    if (this->changed(&this->program, program)) glUseProgram(program);
+}
+
+void gl_state::bindVertexArray(GLuint vertexArray) {
+    if (this->changed(&this->vertexArray, vertexArray)) glBindVertexArray(vertexArray);
+}
+
+void gl_state::bindBuffer(GLenum target, GLuint buffer) {
+    if (this->changed(this->bufferBinding(target), buffer)) glBindBuffer(target, buffer);
+}
+
+void gl_state::bindUniformBuffer(GLuint index, GLuint buffer) {
+    GLuint *binding = index < GL_STATE_UNIFORM_BINDINGS ? &this->uniformBuffers[index] : nullptr;
+    if (this->changed(binding, buffer)) {
+        glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+        *this->bufferBinding(GL_UNIFORM_BUFFER) = buffer;
+    }
+}
+
+void gl_state::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    GLuint *binding = this->textureBinding(unit, target);
+    if (binding && *binding == texture) {
+        this->current.skipped++;
+        return;
+    }
+
+    this->activateUnit(unit);
+    this->changed(binding, texture);
+    glBindTexture(target, texture);
+}
+
+void gl_state::bindTexture(GLenum target, GLuint texture) {
+    if (this->activeUnit == UNKNOWN) this->activateUnit(0);
+    this->bindTexture(this->activeUnit, target, texture);
+}
+
+// deleting a bound object unbinds it, so the cache has to follow along
+
+void gl_state::deleteProgram(GLuint program) {
+    // a program in use lives on until another replaces it, so its name may not be reused yet
+    if (this->program == program) this->useProgram(0);
+    glDeleteProgram(program);
+}
+
+void gl_state::deleteVertexArray(GLuint vertexArray) {
+    if (this->vertexArray == vertexArray) this->vertexArray = 0;
+    glDeleteVertexArrays(1, &vertexArray);
+}
+
+void gl_state::deleteBuffer(GLuint buffer) {
+    for (GLuint &bound : this->buffers) {
+        if (bound == buffer) bound = 0;
+    }
+    for (GLuint &bound : this->uniformBuffers) {
+        if (bound == buffer) bound = 0;
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void gl_state::deleteTexture(GLuint texture) {
+    for (auto &unit : this->textures) {
+        for (GLuint &bound : unit) {
+            if (bound == texture) bound = 0;
+        }
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void gl_state::invalidate() {
+    this->program = UNKNOWN;
+    this->vertexArray = UNKNOWN;
+    this->activeUnit = UNKNOWN;
+    this->buffers.fill(UNKNOWN);
+    this->uniformBuffers.fill(UNKNOWN);
+    for (auto &unit : this->textures) unit.fill(UNKNOWN);
+}
+
+void gl_state::endFrame() {
+    this->last = this->current;
+    this->current = {};
+}
+
+gl_state_counts gl_state::frameCounts() const {
+    return this->last;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+#define GL_STATE_TEXTURE_UNITS 16 // the texture units whose bindings are tracked
+#define GL_STATE_UNIFORM_BINDINGS 4 // the indexed uniform buffer bindings which are tracked
+
+/**
+ * Counts of the binds made through the cache.
+ */
+struct gl_state_counts {
+    size_t issued; // binds which reached the driver
+    size_t skipped; // binds which matched what was already bound
+};
+
+/**
+ * A cache of the programs, vertex arrays, buffers and textures bound
+ * to the context, which skips any bind matching what is already there.
+ *
+ * Binds are left in place rather than reset to 0, so everything which
+ * binds these objects must go through the cache, as must deleting them,
+ * or the cache will believe something else is bound. Code which binds
+ * behind its back has to call invalidate() afterwards.
+ */
+class gl_state {
+public:
+    static gl_state &getInstance() {
+        static gl_state instance;
+        return instance;
+    }
+
+    gl_state(gl_state const &) = delete;
+
+    void operator=(gl_state const &) = delete;
+
+    void useProgram(GLuint program);
+
+    void bindVertexArray(GLuint vertexArray);
+
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    /**
+     * Binds a buffer to an indexed uniform binding, which also binds it to GL_UNIFORM_BUFFER.
+     */
+    void bindUniformBuffer(GLuint index, GLuint buffer);
+
+    /**
+     * Binds a texture to the given unit, switching the active unit only if it has to.
+     */
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    /**
+     * Binds a texture to whichever unit is active, for creating and uploading it.
+     */
+    void bindTexture(GLenum target, GLuint texture);
+
+    void deleteProgram(GLuint program);
+
+    void deleteVertexArray(GLuint vertexArray);
+
+    void deleteBuffer(GLuint buffer);
+
+    void deleteTexture(GLuint texture);
+
+    /**
+     * Forgets everything, so the next bind of each kind always reaches the driver.
+     */
+    void invalidate();
+
+    /**
+     * Finishes counting the binds of this frame.
+     */
+    void endFrame();
+
+    /**
+     * The binds made over the last finished frame.
+     */
+    gl_state_counts frameCounts() const;
+
+private:
+    // the texture targets and buffer targets this renderer uses, anything else is passed straight through
+    static constexpr std::array<GLenum, 3> textureTargets = {
+            GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER
+    };
+    static constexpr std::array<GLenum, 6> bufferTargets = {
+            GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+            GL_DRAW_INDIRECT_BUFFER
+    };
+
+    static constexpr GLuint UNKNOWN = ~0u; // the binding isn't known, so must be made
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    std::array<GLuint, bufferTargets.size()> buffers;
+    std::array<GLuint, GL_STATE_UNIFORM_BINDINGS> uniformBuffers;
+    std::array<std::array<GLuint, textureTargets.size()>, GL_STATE_TEXTURE_UNITS> textures;
+    gl_state_counts current{};
+    gl_state_counts last{};
+
+    gl_state();
+
+    bool changed(GLuint *bound, GLuint object);
+
+    GLuint *bufferBinding(GLenum target);
+
+    GLuint *textureBinding(GLuint unit, GLenum target);
+
+    void activateUnit(GLuint unit);
+};
@@ -14,6 +14,7 @@
 #include "../lib/imgui_impl_opengl3.h"
 #include "initialize.hpp"
 #include "settings.hpp"
+#include "shader_compiler.hpp"
 #include "systems/entity_control.hpp"
 #include "systems/render.hpp"
 
@@ -89,6 +90,9 @@ GLFWwindow *initializeOpenGL() {
 
     glfwSetWindowSizeCallback(window, window_size_callback);
 
+    // shaders are compiled in the background from here on
+    shader_compiler::getInstance().open(window);
+
     return window;
 }
 
@@ -113,6 +117,7 @@ void initializeInput(GLFWwindow *window) {
 }
 
 void teardown() {
+    shader_compiler::getInstance().close();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -7,6 +7,7 @@
  */
 
 #include <iostream>
+#include <optional>
 #include <variant>
 
 #include <glad/glad.h>
@@ -15,13 +16,18 @@
 #include <imgui.h>
 
 #include "initialize.hpp"
+#include "asset_loader.hpp"
+#include "geometry_pool.hpp"
+#include "gl_state.hpp"
 #include "settings.hpp"
+#include "shader_compiler.hpp"
 #include "components/components.hpp"
 #include "systems/render.hpp"
 #include "systems/entity_control.hpp"
 #include "systems/fish_population.hpp"
 #include "systems/physics.hpp"
 #include "systems/boids.hpp"
+#include "systems/transform.hpp"
 
 int main() {
     auto &settings = Settings::getInstance();
@@ -30,23 +36,29 @@ int main() {
     auto *window = initializeOpenGL();
     initializeUI(window);
     initializeInput(window);
+    initializeFishPopulation(registry);
 
     shader partyFish = shader("shaders/vertex_fish.glsl", "shaders/fragment_party_fish.glsl");
-    renderable instancedFishModel = renderable("models/fish.obj", partyFish);
-
-    // set up buffers for instancing
-    GLuint modelBuffer;
-    glGenBuffers(1, &modelBuffer);
-    instancedFishModel.addVertexAttributeMatrix(3, modelBuffer);
-    GLuint timeBuffer;
-    glGenBuffers(1, &timeBuffer);
-    instancedFishModel.addVertexAttributeFloat(7, timeBuffer);
-    GLuint hueBuffer;
-    glGenBuffers(1, &hueBuffer);
-    instancedFishModel.addVertexAttributeFloat(8, hueBuffer);
+    renderable instancedFishModel = renderable("models/fish.obj", partyFish, HUE_VARIANTS);
+
+    // the swim cycle of every vertex, and the fish from every side for drawing far away ones
+    // as billboards, are baked once the fish has loaded and the bake shader has compiled
+    std::optional<swim_animation> fishSwimAnimation;
+    std::optional<impostor_atlas> fishImpostors;
+    shader fishBake = shader("shaders/vertex_fish.glsl", "shaders/fragment_fish_bake.glsl");
+    shader fishImpostor = shader("shaders/vertex_fish_impostor.glsl", "shaders/fragment_fish_impostor.glsl");
+    renderable impostorQuad = renderable("models/plane.obj", fishImpostor);
+
+    // set up buffers for the frame uniforms and instancing
+    frame_uniform_buffer frameUniforms;
+    stream_buffer instanceStream;
+    instance_slots instanceSlots;
+    fish_culling fishCulling;
 
     shader speaker = shader("shaders/vertex_speaker.glsl", "shaders/fragment_speaker.glsl");
     renderable cubeModel = renderable("models/cube.obj", speaker);
+    render_queue renderQueue;
+    model_handle cube = renderQueue.add(cubeModel);
 
     auto cam = registry.create();
     registry.assign<position>(cam, glm::vec3(0,10,40), glm::quatLookAt(glm::normalize(glm::vec3(0,0.2,-0.8)), glm::vec3(0,1,0)));
@@ -56,7 +68,7 @@ int main() {
     for (int i : {0, 1, 2}) {
         auto speakerEntity = registry.create();
         registry.assign<position>(speakerEntity, glm::vec3(0,i * 1.5,0), glm::quatLookAt(glm::vec3(0,0,1), glm::vec3(0,1,0)));
-        registry.assign<renderable>(speakerEntity, cubeModel);
+        registry.assign<model_handle>(speakerEntity, cube);
     }
 
     double currentTime;
@@ -68,18 +80,38 @@ int main() {
         deltaTime = currentTime - lastTime;
         lastTime = currentTime;
 
+        settings.publish();
+
+        // send off any shaders made since last frame, and copy whatever has finished loading to the gpu,
+        // a little each frame
+        shader_compiler::getInstance().update();
+        asset_loader::getInstance().upload((size_t) settings.snapshot()->upload_budget * 1024);
+        if (!fishImpostors && instancedFishModel.resident() && fishBake.ready()) {
+            fishSwimAnimation.emplace(instancedFishModel);
+            if (!fishSwimAnimation->baked()) fishSwimAnimation.reset();
+            fishImpostors.emplace(instancedFishModel, fishBake, instancedFishModel.getBoundingRadius() + SWIM_MARGIN);
+        }
+
         /* Run Systems */
         fish_physics(registry, deltaTime);
         physics(registry, deltaTime);
         fish_population(registry);
 		boids(registry, &cam, deltaTime);
+        transforms(registry);
+
+        // sample input as late as possible, just before building the view
+        glfwPollEvents();
+        sample_input(registry, &cam, deltaTime);
 
         auto color = settings.color;
         glClearColor(color[0], color[1], color[2], 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        renderRenderables(registry, &cam, deltaTime);
-        renderFish(registry, &cam, partyFish, instancedFishModel, modelBuffer, timeBuffer, hueBuffer);
+        updateFrame(registry, &cam, frameUniforms, deltaTime);
+        renderRenderables(registry, renderQueue);
+        renderFish(registry, partyFish, instancedFishModel, fishSwimAnimation ? &*fishSwimAnimation : nullptr,
+                   fishImpostor, impostorQuad, fishImpostors ? &*fishImpostors : nullptr, instanceStream,
+                   instanceSlots, fishCulling);
         if (settings.enable_menu) {
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
             renderUI();
@@ -93,12 +125,22 @@ int main() {
             std::cout << "Render Error: 0x" << std::hex << error << std::endl;
         }
 
+        gl_state::getInstance().endFrame();
         glfwSwapBuffers(window);
-        glfwPollEvents();
     }
 
+    frameUniforms.close();
+    renderQueue.close();
+    instanceStream.close();
+    instanceSlots.close();
+    fishCulling.close();
+    if (fishImpostors) fishImpostors->close();
+    if (fishSwimAnimation) fishSwimAnimation->close();
+    asset_loader::getInstance().close();
+    geometry_pool::getInstance().close();
     teardown();
     instancedFishModel.close();
+    impostorQuad.close();
     cubeModel.close();
 }
 
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bake.hpp"
+#include "optimize.hpp"
+#include "simplify.hpp"
+
+/**
+ * The start of a baked mesh, which is followed by its packed vertices
+ * and then its indices. Everything is stored in the byte order of the
+ * machine which baked it, little endian on every platform built for.
+ */
+struct baked_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    float boundingRadius;
+    uint32_t padding[2];
+    baked_lod lods[MAX_LODS];
+    char diffuse[BAKED_TEXTURE_NAME];
+    char roughness[BAKED_TEXTURE_NAME];
+    char metallic[BAKED_TEXTURE_NAME];
+};
+
+static_assert(sizeof(baked_header) % alignof(packed_vertex) == 0, "the vertices must be aligned after the header");
+
+mesh_view mesh_data::view() const {
+    return {this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(),
+            this->lods, this->boundingRadius, this->textures};
+}
+
+/**
+ * Finds the radius of the smallest sphere about the
+ * model's origin which contains all of its vertices.
+ */
+static float boundingRadius(const obj_model &model) {
+    const auto &vertices = model.attrib.vertices;
+    float radius = 0.0f;
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        radius = std::max(radius, std::sqrt(vertices[i] * vertices[i] + vertices[i + 1] * vertices[i + 1]
+                                            + vertices[i + 2] * vertices[i + 2]));
+    }
+    return radius;
+}
+
+bool bakeMesh(const obj_model &model, mesh_data &mesh) {
+    // only support triangles
+    const uint8_t faceSides = 3;
+
+    size_t triangles = 0;
+    for (const auto &shape : model.shapes) {
+        triangles += shape.mesh.num_face_vertices.size();
+        for (auto vert : shape.mesh.num_face_vertices) {
+            if (vert != faceSides) return false;
+        }
+    }
+
+    std::vector<float> vec;
+    const auto &vertices = model.attrib.vertices;
+    const auto &normals = model.attrib.normals;
+    const auto &texcoords = model.attrib.texcoords;
+    vec.reserve(triangles * faceSides * VERTEX_FLOATS);
+    for (const auto &shape : model.shapes) {
+        for (auto index : shape.mesh.indices) {
+            for (int i = 0; i < faceSides; i++) vec.push_back(vertices[index.vertex_index * 3 + i]);
+            for (int i = 0; i < faceSides; i++) vec.push_back(normals[index.normal_index * 3 + i]);
+
+            //texture coordinates with inverted Y
+            vec.push_back(texcoords[index.texcoord_index * 2]);
+            vec.push_back(1.0f - texcoords[index.texcoord_index * 2 + 1]);
+        }
+    }
+
+    // stop once simplifying stops paying off, or the model is already tiny
+    std::vector<std::vector<float>> levels = {vec};
+    while (levels.size() < MAX_LODS && triangles / 2 >= MIN_LOD_TRIANGLES) {
+        std::vector<float> simplified = simplifyMesh(vec, triangles / 2);
+        const size_t simplifiedTriangles = simplified.size() / (3 * VERTEX_FLOATS);
+        if (simplifiedTriangles * 5 > triangles * 4) break;
+
+        levels.push_back(std::move(simplified));
+        triangles = simplifiedTriangles;
+    }
+
+    // every level's vertices go one after the other, with its indices counting from the first of them all
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.lods.clear();
+    for (const std::vector<float> &level : levels) {
+        std::vector<float> levelVertices;
+        std::vector<uint32_t> levelIndices;
+        indexMesh(level, levelVertices, levelIndices);
+        optimizeVertexCache(levelIndices, levelVertices.size() / VERTEX_FLOATS);
+        optimizeOverdraw(levelIndices, levelVertices);
+        optimizeVertexFetch(levelVertices, levelIndices);
+
+        const auto levelFirst = (uint32_t) mesh.vertices.size();
+        mesh.lods.push_back({(uint32_t) mesh.indices.size(), (uint32_t) levelIndices.size()});
+        for (uint32_t index : levelIndices) mesh.indices.push_back(levelFirst + index);
+        for (size_t vertex = 0; vertex < levelVertices.size(); vertex += VERTEX_FLOATS) {
+            mesh.vertices.push_back(packVertex(&levelVertices[vertex]));
+        }
+    }
+
+    mesh.boundingRadius = boundingRadius(model);
+
+    // todo(arlyon) only supports one material (the first)
+    mesh.textures = {};
+    if (!model.materials.empty()) {
+        const auto &material = model.materials[0];
+        mesh.textures = {material.diffuse_texname, material.roughness_texname, material.metallic_texname};
+    }
+
+    return true;
+}
+
+std::string bakedMeshPath(const std::string &modelPath) {
+    const size_t extension = modelPath.find_last_of('.');
+    const size_t directory = modelPath.find_last_of("/\\");
+    if (extension == std::string::npos || (directory != std::string::npos && extension < directory)) {
+        return modelPath + BAKED_MESH_EXTENSION;
+    }
+    return modelPath.substr(0, extension) + BAKED_MESH_EXTENSION;
+}
+
+static bool copyName(char *to, const std::string &name) {
+    if (name.size() >= BAKED_TEXTURE_NAME) return false;
+    std::memcpy(to, name.c_str(), name.size() + 1);
+    return true;
+}
+
+bool writeBakedMesh(const std::string &path, const mesh_view &mesh) {
+    if (mesh.lods.size() > MAX_LODS) return false;
+
+    baked_header header{};
+    header.magic = BAKED_MESH_MAGIC;
+    header.version = BAKED_MESH_VERSION;
+    header.vertexCount = (uint32_t) mesh.vertexCount;
+    header.indexCount = (uint32_t) mesh.indexCount;
+    header.lodCount = (uint32_t) mesh.lods.size();
+    header.boundingRadius = mesh.boundingRadius;
+    std::copy(mesh.lods.begin(), mesh.lods.end(), header.lods);
+    if (!copyName(header.diffuse, mesh.textures.diffuse) || !copyName(header.roughness, mesh.textures.roughness)
+        || !copyName(header.metallic, mesh.textures.metallic)) {
+        return false;
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(mesh.vertices), mesh.vertexCount * sizeof(packed_vertex));
+    file.write(reinterpret_cast<const char *>(mesh.indices), mesh.indexCount * sizeof(uint32_t));
+    return file.good();
+}
+
+mapped_mesh::~mapped_mesh() {
+    this->close();
+}
+
+bool mapped_mesh::open(const std::string &path) {
+    this->close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    // the view keeps the mapping alive after its handle is closed
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return false;
+    this->size = (size_t) fileSize.QuadPart;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat status{};
+    void *view = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        view = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file);
+    if (view == MAP_FAILED) return false;
+    this->size = (size_t) status.st_size;
+
+    // the whole file is about to be copied to the driver, so start reading it in now
+    posix_madvise(view, this->size, POSIX_MADV_WILLNEED);
+#endif
+    this->data = static_cast<const char *>(view);
+
+    // anything which doesn't add up is treated as missing, and the obj is loaded instead
+    const auto *header = reinterpret_cast<const baked_header *>(this->data);
+    bool valid = this->size >= sizeof(baked_header)
+                       && header->magic == BAKED_MESH_MAGIC && header->version == BAKED_MESH_VERSION
+                       && header->lodCount > 0 && header->lodCount <= MAX_LODS
+                       && this->size >= sizeof(baked_header) + (size_t) header->vertexCount * sizeof(packed_vertex)
+                                        + (size_t) header->indexCount * sizeof(uint32_t)
+                       && header->diffuse[BAKED_TEXTURE_NAME - 1] == '\0'
+                       && header->roughness[BAKED_TEXTURE_NAME - 1] == '\0'
+                       && header->metallic[BAKED_TEXTURE_NAME - 1] == '\0'
+                       && std::all_of(header->lods, header->lods + header->lodCount, [&](const baked_lod &lod) {
+                           return (size_t) lod.firstIndex + lod.indices <= header->indexCount;
+                       });
+
+    // the indices go to the driver unchecked, so one past the vertices would draw from another model's
+    if (valid) {
+        const mesh_view mesh = this->view();
+        valid = std::all_of(mesh.indices, mesh.indices + mesh.indexCount,
+                            [&](uint32_t index) { return index < mesh.vertexCount; });
+    }
+    if (!valid) this->close();
+    return valid;
+}
+
+mesh_view mapped_mesh::view() const {
+    const auto *header = reinterpret_cast<const baked_header *>(this->data);
+    const auto *vertices = reinterpret_cast<const packed_vertex *>(this->data + sizeof(baked_header));
+    const auto *indices = reinterpret_cast<const uint32_t *>(vertices + header->vertexCount);
+    return {vertices, header->vertexCount, indices, header->indexCount,
+            std::vector<baked_lod>(header->lods, header->lods + header->lodCount), header->boundingRadius,
+            {header->diffuse, header->roughness, header->metallic}};
+}
+
+void mapped_mesh::close() {
+    if (!this->data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(this->data);
+#else
+    munmap(const_cast<char *>(this->data), this->size);
+#endif
+    this->data = nullptr;
+    this->size = 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "obj_loader.hpp"
+#include "pack.hpp"
+
+#define MAX_LODS 4 // the most levels of detail generated for a model
+#define MIN_LOD_TRIANGLES 64 // models are not simplified below this
+
+#define BAKED_MESH_MAGIC 0x48534d41u // "AMSH", read little endian
+#define BAKED_MESH_VERSION 1 // bumped whenever the layout or the processing changes, so old bakes are ignored
+#define BAKED_MESH_EXTENSION ".mesh"
+#define BAKED_TEXTURE_NAME 256 // the room for each texture path, including its terminator
+
+/**
+ * A range of a model's indices for one level of detail,
+ * counting from the model's first vertex and first index.
+ */
+struct baked_lod {
+    uint32_t firstIndex;
+    uint32_t indices;
+};
+
+/**
+ * The texture paths of a model's material, empty where it has none.
+ */
+struct baked_textures {
+    std::string diffuse;
+    std::string roughness;
+    std::string metallic;
+};
+
+/**
+ * A model's geometry ready to copy into the geometry pool, pointing
+ * either into a mapped baked mesh or into a mesh_data built from an obj.
+ */
+struct mesh_view {
+    const packed_vertex *vertices;
+    size_t vertexCount;
+    const uint32_t *indices;
+    size_t indexCount;
+    std::vector<baked_lod> lods; // the full model first, then simpler versions
+    float boundingRadius; // the radius of a sphere about the origin containing the model
+    baked_textures textures;
+};
+
+/**
+ * A model's geometry built from an obj, as meshbake writes it.
+ */
+struct mesh_data {
+    std::vector<packed_vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<baked_lod> lods;
+    float boundingRadius;
+    baked_textures textures;
+
+    mesh_view view() const;
+};
+
+/**
+ * Builds a model's geometry from an obj.
+ *
+ * Simplified levels of detail are generated after the full model,
+ * halving the triangles each time. Each level is welded into an index
+ * buffer, its triangles ordered for the vertex cache and then overdraw,
+ * and its vertices ordered for fetching, then packed.
+ *
+ * @returns Whether the model was made only of triangles.
+ */
+bool bakeMesh(const obj_model &model, mesh_data &mesh);
+
+/**
+ * Gets where the baked copy of a model lives, beside it with BAKED_MESH_EXTENSION.
+ */
+std::string bakedMeshPath(const std::string &modelPath);
+
+/**
+ * Writes a model's geometry out as a baked mesh.
+ * @returns Whether it could be written.
+ */
+bool writeBakedMesh(const std::string &path, const mesh_view &mesh);
+
+/**
+ * A baked mesh mapped read-only into memory, so its vertices and
+ * indices can be handed to the driver without being copied or parsed.
+ * The views it gives out are only valid for as long as it is open.
+ */
+class mapped_mesh {
+public:
+    mapped_mesh() = default;
+
+    mapped_mesh(mapped_mesh const &) = delete;
+
+    void operator=(mapped_mesh const &) = delete;
+
+    ~mapped_mesh();
+
+    /**
+     * Maps a baked mesh, checking it is one of this version, is whole, and
+     * has no index past its vertices.
+     * @returns Whether it could be mapped, if not the model has to be loaded from its obj.
+     */
+    bool open(const std::string &path);
+
+    mesh_view view() const;
+
+    void close();
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+};
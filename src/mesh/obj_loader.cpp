@@ -0,0 +1,506 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+
+#include "obj_loader.hpp"
+#include "../thread_pool.hpp"
+
+/**
+ * The part of an obj parsed from one chunk, with its indices
+ * counting from the start of the chunk where they were relative.
+ */
+struct obj_chunk {
+    std::vector<tinyobj::real_t> vertices, normals, texcoords, colors;
+    std::vector<tinyobj::index_t> corners; // the corners of every face, one after another
+    std::vector<size_t> faceSizes;
+    std::vector<size_t> relative; // the components of corners which count back from the end of the chunk, as corner * 3 + component
+    std::vector<std::pair<size_t, std::string>> materials; // the face from which each usemtl applies
+    std::vector<std::pair<size_t, unsigned int>> smoothing; // the face from which each s applies
+    std::vector<std::pair<size_t, std::string>> shapes; // the face from which each g or o starts a shape, with its name
+    std::string materialLibrary;
+    bool valid = true;
+
+    // filled in once the chunks are merged
+    std::vector<tinyobj::index_t> triangles;
+    std::vector<int> materialIds; // per triangle
+    std::vector<unsigned int> smoothingIds; // per triangle
+    std::vector<size_t> faceTriangles; // the first triangle of each face, and one past the last
+};
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+/**
+ * Reads a float from the line, leaving it at zero if there isn't one.
+ */
+static const char *readFloat(const char *p, const char *end, tinyobj::real_t &value, bool &found) {
+    p = skipBlanks(p, end);
+    value = 0;
+    found = false;
+    if (p == end || *p == '\n') return p;
+
+    char *after;
+    value = (tinyobj::real_t) std::strtod(p, &after);
+    found = after != p;
+    return after;
+}
+
+static const char *readFloat(const char *p, const char *end, tinyobj::real_t &value) {
+    bool found;
+    return readFloat(p, end, value, found);
+}
+
+static const char *readInt(const char *p, const char *end, int &value, bool &found) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    found = false;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+        found = true;
+    }
+    if (negative) value = -value;
+    return p;
+}
+
+/**
+ * A face corner, with which of its components count back from the end of the chunk.
+ */
+struct face_corner {
+    tinyobj::index_t index;
+    bool relative[3];
+};
+
+static std::string readName(const char *p, const char *end) {
+    p = skipBlanks(p, end);
+    const char *last = p;
+    while (last < end && *last != '\n') last++;
+    while (last > p && isBlank(last[-1])) last--;
+    return std::string(p, last);
+}
+
+/**
+ * The rest of the line as it stands, which is how tinyobj names objects and materials.
+ */
+static std::string readRest(const char *p, const char *end) {
+    if (end > p && end[-1] == '\r') end--;
+    return std::string(p, end);
+}
+
+/**
+ * Parses the lines of one chunk.
+ */
+static void parseChunk(const char *p, const char *end, obj_chunk &chunk) {
+    std::vector<face_corner> face;
+    while (p < end) {
+        p = skipBlanks(p, end);
+        const char *line = p;
+        while (p < end && *p != '\n') p++;
+        const char *lineEnd = p;
+        if (p < end) p++;
+        if (line == lineEnd) continue;
+
+        if (line[0] == 'v' && lineEnd - line > 1 && isBlank(line[1])) {
+            // colours may follow the position, and are white where they don't, as in tinyobj
+            tinyobj::real_t x, y, z, r, g, b;
+            bool red, green, blue;
+            const char *q = readFloat(readFloat(readFloat(line + 1, lineEnd, x), lineEnd, y), lineEnd, z);
+            readFloat(readFloat(readFloat(q, lineEnd, r, red), lineEnd, g, green), lineEnd, b, blue);
+            if (!red || !green || !blue) r = g = b = 1;
+            chunk.vertices.insert(chunk.vertices.end(), {x, y, z});
+            chunk.colors.insert(chunk.colors.end(), {r, g, b});
+        } else if (line[0] == 'v' && lineEnd - line > 2 && line[1] == 'n' && isBlank(line[2])) {
+            tinyobj::real_t x, y, z;
+            readFloat(readFloat(readFloat(line + 2, lineEnd, x), lineEnd, y), lineEnd, z);
+            chunk.normals.insert(chunk.normals.end(), {x, y, z});
+        } else if (line[0] == 'v' && lineEnd - line > 2 && line[1] == 't' && isBlank(line[2])) {
+            tinyobj::real_t u, v;
+            readFloat(readFloat(line + 2, lineEnd, u), lineEnd, v);
+            chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+        } else if (line[0] == 'f' && lineEnd - line > 1 && isBlank(line[1])) {
+            // each corner is v, v/t, v//n or v/t/n
+            face.clear();
+            const char *q = skipBlanks(line + 1, lineEnd);
+            while (q < lineEnd) {
+                int raw[3] = {0, 0, 0};
+                bool found[3] = {false, false, false};
+                q = readInt(q, lineEnd, raw[0], found[0]);
+                for (int component = 1; component < 3 && q < lineEnd && *q == '/'; component++) {
+                    q = readInt(q + 1, lineEnd, raw[component], found[component]);
+                }
+                if (!found[0]) {
+                    chunk.valid = false;
+                    return;
+                }
+
+                // positive indices count from 1 at the start of the file, negative ones back from
+                // the latest element, which is only known within the chunk until they're merged
+                face_corner corner{{-1, -1, -1}, {false, false, false}};
+                const size_t counts[3] = {chunk.vertices.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3};
+                int *targets[3] = {&corner.index.vertex_index, &corner.index.texcoord_index, &corner.index.normal_index};
+                for (int component = 0; component < 3; component++) {
+                    if (!found[component]) continue;
+                    if (raw[component] == 0) {
+                        chunk.valid = false;
+                        return;
+                    }
+                    corner.relative[component] = raw[component] < 0;
+                    *targets[component] = raw[component] > 0 ? raw[component] - 1 : (int) counts[component] + raw[component];
+                }
+                face.push_back(corner);
+                q = skipBlanks(q, lineEnd);
+            }
+
+            // the face is triangulated once merged, when the positions of all its corners are known
+            for (const face_corner &corner : face) {
+                for (size_t component = 0; component < 3; component++) {
+                    if (corner.relative[component]) chunk.relative.push_back(chunk.corners.size() * 3 + component);
+                }
+                chunk.corners.push_back(corner.index);
+            }
+            chunk.faceSizes.push_back(face.size());
+        } else if (line[0] == 'g' && lineEnd - line > 1 && isBlank(line[1])) {
+            // several group names are joined into one, as in tinyobj
+            std::string name;
+            for (const char *q = skipBlanks(line + 1, lineEnd); q < lineEnd; q = skipBlanks(q, lineEnd)) {
+                const char *word = q;
+                while (q < lineEnd && !isBlank(*q)) q++;
+                name += (name.empty() ? "" : " ") + std::string(word, q);
+            }
+            chunk.shapes.emplace_back(chunk.faceSizes.size(), name);
+        } else if (line[0] == 'o' && lineEnd - line > 1 && isBlank(line[1])) {
+            chunk.shapes.emplace_back(chunk.faceSizes.size(), readRest(line + 2, lineEnd));
+        } else if (line[0] == 's' && lineEnd - line > 1 && isBlank(line[1])) {
+            // read as tinyobj reads it, which only takes ids of up to two digits
+            const std::string id = readRest(skipBlanks(line + 2, lineEnd), lineEnd);
+            if (id.size() >= 3) {
+                if (id.compare(0, 3, "off") == 0) chunk.smoothing.emplace_back(chunk.faceSizes.size(), 0);
+            } else if (!id.empty()) {
+                chunk.smoothing.emplace_back(chunk.faceSizes.size(), (unsigned int) std::max(std::atoi(id.c_str()), 0));
+            }
+        } else if (lineEnd - line > 6 && std::strncmp(line, "usemtl", 6) == 0 && isBlank(line[6])) {
+            chunk.materials.emplace_back(chunk.faceSizes.size(), readRest(line + 7, lineEnd));
+        } else if (lineEnd - line > 6 && std::strncmp(line, "mtllib", 6) == 0 && isBlank(line[6])) {
+            if (chunk.materialLibrary.empty()) chunk.materialLibrary = readName(line + 6, lineEnd);
+        }
+    }
+}
+
+/**
+ * Whether the point lies within the triangle, by counting the edges a ray from it crosses.
+ */
+static bool contains(const tinyobj::real_t *x, const tinyobj::real_t *y, tinyobj::real_t px, tinyobj::real_t py) {
+    bool inside = false;
+    for (size_t i = 0, j = 2; i < 3; j = i++) {
+        if ((y[i] > py) != (y[j] > py) && px < (x[j] - x[i]) * (py - y[i]) / (y[j] - y[i]) + x[i]) inside = !inside;
+    }
+    return inside;
+}
+
+/**
+ * Splits a face into triangles by clipping ears off it, step for step as
+ * tinyobj does, so large files come out the same as small ones. Faces
+ * which can't be clipped down to one last triangle lose what's left.
+ */
+static void triangulate(const tinyobj::index_t *face, size_t count, const std::vector<tinyobj::real_t> &v,
+                        std::vector<tinyobj::index_t> &triangles) {
+    if (count < 3) return;
+    auto inRange = [&](const tinyobj::index_t &corner) {
+        return corner.vertex_index >= 0 && (size_t) corner.vertex_index < v.size() / 3;
+    };
+
+    // work in the plane of the two axes the first proper corner is widest across
+    size_t axes[2] = {1, 2};
+    for (size_t k = 0; k < count; k++) {
+        const tinyobj::index_t &a = face[k], &b = face[(k + 1) % count], &c = face[(k + 2) % count];
+        if (!inRange(a) || !inRange(b) || !inRange(c)) continue;
+        const tinyobj::real_t *p0 = &v[(size_t) a.vertex_index * 3];
+        const tinyobj::real_t *p1 = &v[(size_t) b.vertex_index * 3];
+        const tinyobj::real_t *p2 = &v[(size_t) c.vertex_index * 3];
+        const tinyobj::real_t e0x = p1[0] - p0[0], e0y = p1[1] - p0[1], e0z = p1[2] - p0[2];
+        const tinyobj::real_t e1x = p2[0] - p1[0], e1y = p2[1] - p1[1], e1z = p2[2] - p1[2];
+        const tinyobj::real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+        const tinyobj::real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+        const tinyobj::real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+        const tinyobj::real_t epsilon = std::numeric_limits<tinyobj::real_t>::epsilon();
+        if (cx > epsilon || cy > epsilon || cz > epsilon) {
+            if (!(cx > cy && cx > cz)) {
+                axes[0] = 0;
+                if (cz > cx && cz > cy) axes[1] = 1;
+            }
+            break;
+        }
+    }
+
+    // the winding, which tells the face's convex corners from its reflex ones
+    tinyobj::real_t area = 0;
+    for (size_t k = 0; k < count; k++) {
+        const tinyobj::index_t &a = face[k], &b = face[(k + 1) % count];
+        if (!inRange(a) || !inRange(b)) continue;
+        const tinyobj::real_t *p0 = &v[(size_t) a.vertex_index * 3];
+        const tinyobj::real_t *p1 = &v[(size_t) b.vertex_index * 3];
+        area += (p0[axes[0]] * p1[axes[1]] - p0[axes[1]] * p1[axes[0]]) * (tinyobj::real_t) 0.5;
+    }
+
+    std::vector<tinyobj::index_t> remaining(face, face + count);
+    size_t guess = 0;
+    size_t iterations = count; // how many corners may be tried before one has to be clipped
+    size_t previous = count;
+    while (remaining.size() > 3 && iterations > 0) {
+        const size_t corners = remaining.size();
+        if (guess >= corners) guess -= corners;
+        if (previous != corners) {
+            previous = corners;
+            iterations = corners;
+        } else {
+            iterations--;
+        }
+
+        tinyobj::index_t ear[3];
+        tinyobj::real_t x[3], y[3];
+        for (size_t k = 0; k < 3; k++) {
+            ear[k] = remaining[(guess + k) % corners];
+            const bool valid = inRange(ear[k]);
+            x[k] = valid ? v[(size_t) ear[k].vertex_index * 3 + axes[0]] : 0;
+            y[k] = valid ? v[(size_t) ear[k].vertex_index * 3 + axes[1]] : 0;
+        }
+        const tinyobj::real_t cross = (x[1] - x[0]) * (y[2] - y[1]) - (y[1] - y[0]) * (x[2] - x[1]);
+        if (cross * area < 0) {
+            guess++;
+            continue;
+        }
+
+        // it's only an ear if none of the other corners lie within it
+        bool overlap = false;
+        for (size_t other = 3; other < corners && !overlap; other++) {
+            const tinyobj::index_t &corner = remaining[(guess + other) % corners];
+            if (!inRange(corner)) continue;
+            const tinyobj::real_t *p = &v[(size_t) corner.vertex_index * 3];
+            overlap = contains(x, y, p[axes[0]], p[axes[1]]);
+        }
+        if (overlap) {
+            guess++;
+            continue;
+        }
+
+        triangles.insert(triangles.end(), ear, ear + 3);
+        remaining.erase(remaining.begin() + (long) ((guess + 1) % corners));
+    }
+
+    if (remaining.size() == 3) triangles.insert(triangles.end(), remaining.begin(), remaining.end());
+}
+
+bool parseObj(const std::string &text, const std::string &path, obj_model &model, size_t chunkBytes, bool parallel) {
+    const size_t size = text.size();
+    const size_t slash = path.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    // cut the file into chunks, moving each cut to just after the end of a line
+    const size_t chunkCount = std::max<size_t>(size / chunkBytes, 1);
+    std::vector<size_t> cuts = {0};
+    for (size_t chunk = 1; chunk < chunkCount; chunk++) {
+        size_t cut = std::max(size * chunk / chunkCount, cuts.back());
+        while (cut < size && text[cut - 1] != '\n') cut++;
+        cuts.push_back(cut);
+    }
+    cuts.push_back(size);
+
+    auto forChunks = [&](const std::function<void(size_t begin, size_t end)> &body) {
+        if (parallel) thread_pool::getInstance().parallel_for(chunkCount, 1, body);
+        else body(0, chunkCount);
+    };
+
+    std::vector<obj_chunk> chunks(chunkCount);
+    forChunks([&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            parseChunk(text.data() + cuts[chunk], text.data() + cuts[chunk + 1], chunks[chunk]);
+        }
+    });
+
+    // where each chunk's elements land once merged, so they can be copied in parallel
+    struct chunk_offsets {
+        size_t vertices, normals, texcoords;
+    };
+    std::vector<chunk_offsets> offsets(chunkCount + 1, {0, 0, 0});
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        if (!chunks[chunk].valid) {
+            std::cerr << "Invalid face in " << path << "." << std::endl;
+            return false;
+        }
+        offsets[chunk + 1] = {offsets[chunk].vertices + chunks[chunk].vertices.size(),
+                              offsets[chunk].normals + chunks[chunk].normals.size(),
+                              offsets[chunk].texcoords + chunks[chunk].texcoords.size()};
+    }
+
+    // the material and smoothing group each chunk starts with are whichever the chunks before it left off with
+    std::string materialLibrary;
+    std::vector<std::string> startMaterials(chunkCount);
+    std::vector<unsigned int> startSmoothing(chunkCount, 0);
+    for (size_t chunk = 0; chunk + 1 < chunkCount; chunk++) {
+        startMaterials[chunk + 1] = chunks[chunk].materials.empty() ? startMaterials[chunk]
+                                                                    : chunks[chunk].materials.back().second;
+        startSmoothing[chunk + 1] = chunks[chunk].smoothing.empty() ? startSmoothing[chunk]
+                                                                    : chunks[chunk].smoothing.back().second;
+    }
+    for (const obj_chunk &chunk : chunks) {
+        if (materialLibrary.empty()) materialLibrary = chunk.materialLibrary;
+    }
+
+    std::string warn, err;
+    std::map<std::string, int> materialIds;
+    model.materials.clear();
+    if (!materialLibrary.empty()) {
+        std::ifstream library(directory + materialLibrary);
+        if (library.is_open()) tinyobj::LoadMtl(&materialIds, &model.materials, &library, &warn, &err);
+    }
+    auto materialId = [&](const std::string &name) {
+        auto found = materialIds.find(name);
+        return found == materialIds.end() ? -1 : found->second;
+    };
+
+    const chunk_offsets &total = offsets.back();
+    model.attrib = {};
+    model.attrib.vertices.resize(total.vertices);
+    model.attrib.colors.resize(total.vertices);
+    model.attrib.normals.resize(total.normals);
+    model.attrib.texcoords.resize(total.texcoords);
+
+    forChunks([&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            obj_chunk &chunk = chunks[c];
+            const chunk_offsets &offset = offsets[c];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), model.attrib.vertices.begin() + offset.vertices);
+            std::copy(chunk.colors.begin(), chunk.colors.end(), model.attrib.colors.begin() + offset.vertices);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), model.attrib.normals.begin() + offset.normals);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+                      model.attrib.texcoords.begin() + offset.texcoords);
+
+            // relative indices were resolved against the chunk alone, so shift them by what came before it
+            const int bases[3] = {(int) (offset.vertices / 3), (int) (offset.texcoords / 2), (int) (offset.normals / 3)};
+            for (size_t r : chunk.relative) {
+                tinyobj::index_t &index = chunk.corners[r / 3];
+                int *components[3] = {&index.vertex_index, &index.texcoord_index, &index.normal_index};
+                *components[r % 3] += bases[r % 3];
+            }
+        }
+    });
+
+    // faces may use vertices from any chunk, so they're only triangulated once every chunk is copied in
+    forChunks([&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            obj_chunk &chunk = chunks[c];
+            size_t corner = 0, material = 0, smoothing = 0;
+            int currentMaterial = materialId(startMaterials[c]);
+            unsigned int currentSmoothing = startSmoothing[c];
+            chunk.faceTriangles.assign(1, 0);
+            for (size_t face = 0; face < chunk.faceSizes.size(); face++) {
+                for (; material < chunk.materials.size() && chunk.materials[material].first == face; material++) {
+                    currentMaterial = materialId(chunk.materials[material].second);
+                }
+                for (; smoothing < chunk.smoothing.size() && chunk.smoothing[smoothing].first == face; smoothing++) {
+                    currentSmoothing = chunk.smoothing[smoothing].second;
+                }
+
+                triangulate(chunk.corners.data() + corner, chunk.faceSizes[face], model.attrib.vertices, chunk.triangles);
+                corner += chunk.faceSizes[face];
+                const size_t triangles = chunk.triangles.size() / 3;
+                chunk.materialIds.resize(triangles, currentMaterial);
+                chunk.smoothingIds.resize(triangles, currentSmoothing);
+                chunk.faceTriangles.push_back(triangles);
+            }
+        }
+    });
+
+    // each g or o starts a new shape, and those left without faces are dropped as in tinyobj
+    struct shape_part {
+        size_t chunk, begin, end, shape, at; // a run of a chunk's triangles, and where it lands in its shape
+    };
+    std::vector<std::string> names = {""};
+    std::vector<size_t> shapeTriangles = {0};
+    std::vector<shape_part> parts;
+    for (size_t c = 0; c < chunkCount; c++) {
+        const obj_chunk &chunk = chunks[c];
+        size_t from = 0;
+        auto addPart = [&](size_t to) {
+            if (to == from) return;
+            parts.push_back({c, from, to, names.size() - 1, shapeTriangles.back()});
+            shapeTriangles.back() += to - from;
+            from = to;
+        };
+        for (const auto &start : chunk.shapes) {
+            addPart(chunk.faceTriangles[start.first]);
+            names.push_back(start.second);
+            shapeTriangles.push_back(0);
+        }
+        addPart(chunk.faceTriangles.back());
+    }
+
+    model.shapes.clear();
+    std::vector<size_t> shapeIds(names.size());
+    for (size_t shape = 0; shape < names.size(); shape++) {
+        shapeIds[shape] = model.shapes.size();
+        if (shapeTriangles[shape] == 0) continue;
+
+        model.shapes.emplace_back();
+        model.shapes.back().name = names[shape];
+        tinyobj::mesh_t &mesh = model.shapes.back().mesh;
+        mesh.indices.resize(shapeTriangles[shape] * 3);
+        mesh.num_face_vertices.assign(shapeTriangles[shape], 3);
+        mesh.material_ids.resize(shapeTriangles[shape]);
+        mesh.smoothing_group_ids.resize(shapeTriangles[shape]);
+    }
+
+    forChunks([&](size_t begin, size_t end) {
+        // the parts are in chunk order, so those of these chunks are together
+        auto first = std::lower_bound(parts.begin(), parts.end(), begin,
+                                      [](const shape_part &part, size_t chunk) { return part.chunk < chunk; });
+        for (auto part = first; part != parts.end() && part->chunk < end; part++) {
+            const obj_chunk &chunk = chunks[part->chunk];
+            tinyobj::mesh_t &mesh = model.shapes[shapeIds[part->shape]].mesh;
+            std::copy(chunk.triangles.begin() + (long) (part->begin * 3), chunk.triangles.begin() + (long) (part->end * 3),
+                      mesh.indices.begin() + (long) (part->at * 3));
+            std::copy(chunk.materialIds.begin() + (long) part->begin, chunk.materialIds.begin() + (long) part->end,
+                      mesh.material_ids.begin() + (long) part->at);
+            std::copy(chunk.smoothingIds.begin() + (long) part->begin, chunk.smoothingIds.begin() + (long) part->end,
+                      mesh.smoothing_group_ids.begin() + (long) part->at);
+        }
+    });
+
+    return true;
+}
+
+bool loadObj(const std::string &path, obj_model &model, bool parallel) {
+    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+    const auto size = (size_t) file.tellg();
+
+    if (size < OBJ_PARALLEL_BYTES) {
+        file.close();
+        const size_t slash = path.find_last_of("/\\");
+        const std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+        std::string warn, err;
+        const bool loaded = tinyobj::LoadObj(&model.attrib, &model.shapes, &model.materials, &warn, &err,
+                                             path.c_str(), directory.c_str());
+        if (!err.empty()) std::cerr << err << std::endl;
+        return loaded;
+    }
+
+    std::string text(size, '\0');
+    file.seekg(0);
+    file.read(&text[0], (std::streamsize) size);
+    if (!file) return false;
+    return parseObj(text, path, model, OBJ_CHUNK_BYTES, parallel);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include "../../lib/tiny_obj_loader.h"
+
+#define OBJ_PARALLEL_BYTES (4 * 1024 * 1024) // objs smaller than this are left to tinyobj, splitting them isn't worth it
+#define OBJ_CHUNK_BYTES (1024 * 1024) // the size each chunk of a large obj is cut to, before aligning it to a line
+
+/**
+ * The contents of an obj, laid out the way tinyobj gives them.
+ */
+struct obj_model {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+};
+
+/**
+ * Loads an obj, triangulating its faces. Large files are cut into line
+ * aligned chunks which are parsed in parallel, each into its own arrays,
+ * then merged in order, fixing up the indices which count back from the
+ * end of the chunk. Small files are parsed by tinyobj on this thread.
+ *
+ * @param parallel Whether the chunks may be spread over the thread pool,
+ * otherwise they're parsed in turn on this thread.
+ * @returns Whether the file could be read.
+ */
+bool loadObj(const std::string &path, obj_model &model, bool parallel = true);
+
+/**
+ * Parses an obj already read into memory the way loadObj parses large files,
+ * giving what tinyobj would: faces are clipped into triangles as tinyobj clips
+ * them, each g or o starts a new shape, and smoothing groups and vertex colours
+ * are kept. Lines, points and tags are skipped, as is all but the first mtllib.
+ * Where tinyobj loses the faces before a usemtl when an o follows, they're kept.
+ *
+ * @param path Where the obj was read from, for finding its materials.
+ * @param chunkBytes The size each chunk is cut to, before aligning it to a line.
+ * @returns Whether every face could be read.
+ */
+bool parseObj(const std::string &text, const std::string &path, obj_model &model,
+              size_t chunkBytes = OBJ_CHUNK_BYTES, bool parallel = true);
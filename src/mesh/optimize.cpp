@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+
+#include <glm/glm.hpp>
+
+#include "optimize.hpp"
+
+// the scoring from https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+#define CACHE_SIZE 32 // the vertices the modelled cache holds
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f // the score of the vertices of the last triangle, which are penalised a little
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+#define OVERDRAW_CACHE_SIZE 16 // the fifo cache used to find where the triangle order starts afresh
+#define OVERDRAW_MIN_CLUSTER 16 // the fewest triangles in a cluster, so the cache order isn't broken up too much
+
+void indexMesh(const std::vector<float> &triangles, std::vector<float> &vertices, std::vector<uint32_t> &indices) {
+    std::map<std::array<float, VERTEX_FLOATS>, uint32_t> unique;
+    vertices.clear();
+    indices.clear();
+    indices.reserve(triangles.size() / VERTEX_FLOATS);
+
+    for (size_t corner = 0; corner + VERTEX_FLOATS <= triangles.size(); corner += VERTEX_FLOATS) {
+        std::array<float, VERTEX_FLOATS> vertex;
+        std::copy(triangles.begin() + corner, triangles.begin() + corner + VERTEX_FLOATS, vertex.begin());
+
+        auto found = unique.emplace(vertex, (uint32_t) (vertices.size() / VERTEX_FLOATS));
+        if (found.second) vertices.insert(vertices.end(), vertex.begin(), vertex.end());
+        indices.push_back(found.first->second);
+    }
+}
+
+/**
+ * Scores a vertex by its position in the cache, if it's in it,
+ * boosted when it has few triangles left so they aren't left stranded.
+ */
+static float vertexScore(int cachePosition, uint32_t remaining) {
+    if (remaining == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            const float scaler = 1.0f / (CACHE_SIZE - 3);
+            score = std::pow(1.0f - (float) (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    return score + VALENCE_BOOST_SCALE * std::pow((float) remaining, -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // the triangles not yet emitted around each vertex, as a range of one list
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices) remaining[index]++;
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) offsets[vertex + 1] = offsets[vertex] + remaining[vertex];
+    std::vector<uint32_t> adjacent(indices.size());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adjacent[filled[indices[i]]++] = (uint32_t) (i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+        vertexScores[vertex] = vertexScore(-1, remaining[vertex]);
+    }
+
+    auto triangleScore = [&](size_t triangle) {
+        return vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]]
+               + vertexScores[indices[triangle * 3 + 2]];
+    };
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) triangleScores[triangle] = triangleScore(triangle);
+
+    std::vector<bool> added(triangleCount, false);
+    std::vector<uint32_t> ordered;
+    ordered.reserve(indices.size());
+    std::vector<uint32_t> cache, nextCache, touched;
+    size_t scan = 0; // the triangles before this have all been added
+    long best = -1;
+
+    while (ordered.size() < indices.size()) {
+        // nothing in the cache has triangles left, so carry on from the next one not yet added
+        if (best < 0) {
+            while (added[scan]) scan++;
+            best = (long) scan;
+        }
+
+        const uint32_t *corners = &indices[best * 3];
+        added[best] = true;
+        for (int corner = 0; corner < 3; corner++) {
+            const uint32_t vertex = corners[corner];
+            ordered.push_back(vertex);
+
+            auto begin = adjacent.begin() + offsets[vertex];
+            auto end = begin + remaining[vertex];
+            std::iter_swap(std::find(begin, end, (uint32_t) best), end - 1);
+            remaining[vertex]--;
+        }
+
+        // the triangle's vertices move to the front of the cache, pushing the oldest out
+        nextCache.assign(corners, corners + 3);
+        for (uint32_t vertex : cache) {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) nextCache.push_back(vertex);
+        }
+        for (uint32_t vertex : cache) cachePosition[vertex] = -1;
+        touched = cache;
+        if (nextCache.size() > CACHE_SIZE) nextCache.resize(CACHE_SIZE);
+        for (size_t position = 0; position < nextCache.size(); position++) {
+            cachePosition[nextCache[position]] = (int) position;
+        }
+        touched.insert(touched.end(), corners, corners + 3);
+        cache.swap(nextCache);
+
+        for (uint32_t vertex : touched) vertexScores[vertex] = vertexScore(cachePosition[vertex], remaining[vertex]);
+
+        // only the triangles around the cache changed score, so the next is the best of those
+        best = -1;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : touched) {
+            for (uint32_t i = offsets[vertex]; i < offsets[vertex] + remaining[vertex]; i++) {
+                const uint32_t triangle = adjacent[i];
+                triangleScores[triangle] = triangleScore(triangle);
+                if (cachePosition[vertex] >= 0 && triangleScores[triangle] > bestScore) {
+                    best = triangle;
+                    bestScore = triangleScores[triangle];
+                }
+            }
+        }
+    }
+
+    indices.swap(ordered);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<float> &vertices) {
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    auto positionOf = [&](uint32_t index) {
+        const float *p = &vertices[index * VERTEX_FLOATS];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // a new cluster starts wherever a triangle misses the cache on every vertex
+    std::vector<size_t> clusterStarts;
+    std::vector<size_t> cachedAt(vertices.size() / VERTEX_FLOATS, 0);
+    size_t timestamp = OVERDRAW_CACHE_SIZE + 1;
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        int misses = 0;
+        for (int corner = 0; corner < 3; corner++) {
+            const uint32_t vertex = indices[triangle * 3 + corner];
+            if (timestamp - cachedAt[vertex] > OVERDRAW_CACHE_SIZE) {
+                cachedAt[vertex] = timestamp++;
+                misses++;
+            }
+        }
+
+        const size_t clusterSize = clusterStarts.empty() ? 0 : triangle - clusterStarts.back();
+        if (clusterStarts.empty() || (misses == 3 && clusterSize >= OVERDRAW_MIN_CLUSTER)) {
+            clusterStarts.push_back(triangle);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // the area weighted centre and facing of each cluster, and of the whole mesh
+    const size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<glm::vec3> centres(clusterCount), facings(clusterCount);
+    glm::vec3 meshCentre(0.0f);
+    float meshArea = 0.0f;
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        glm::vec3 centre(0.0f), facing(0.0f);
+        float area = 0.0f;
+        for (size_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++) {
+            const glm::vec3 a = positionOf(indices[triangle * 3]);
+            const glm::vec3 b = positionOf(indices[triangle * 3 + 1]);
+            const glm::vec3 c = positionOf(indices[triangle * 3 + 2]);
+            const glm::vec3 normal = glm::cross(b - a, c - a);
+            const float triangleArea = glm::length(normal);
+            centre += (a + b + c) / 3.0f * triangleArea;
+            facing += normal;
+            area += triangleArea;
+        }
+
+        meshCentre += centre;
+        meshArea += area;
+        centres[cluster] = area > 0.0f ? centre / area : centre;
+        facings[cluster] = glm::length(facing) > 0.0f ? glm::normalize(facing) : facing;
+    }
+    if (meshArea > 0.0f) meshCentre /= meshArea;
+
+    // those furthest out along their facing are drawn first, as they are the most likely to be in front
+    std::vector<float> outwardness(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        outwardness[cluster] = glm::dot(centres[cluster] - meshCentre, facings[cluster]);
+        order[cluster] = cluster;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return outwardness[a] > outwardness[b];
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (size_t cluster : order) {
+        sorted.insert(sorted.end(), indices.begin() + clusterStarts[cluster] * 3,
+                      indices.begin() + clusterStarts[cluster + 1] * 3);
+    }
+    indices.swap(sorted);
+}
+
+void optimizeVertexFetch(std::vector<float> &vertices, std::vector<uint32_t> &indices) {
+    std::vector<uint32_t> remap(vertices.size() / VERTEX_FLOATS, UINT32_MAX);
+    std::vector<float> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t &index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = (uint32_t) (reordered.size() / VERTEX_FLOATS);
+            reordered.insert(reordered.end(), vertices.begin() + index * VERTEX_FLOATS,
+                             vertices.begin() + (index + 1) * VERTEX_FLOATS);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
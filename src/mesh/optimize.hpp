@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "simplify.hpp"
+
+/**
+ * Welds the identical corners of a triangle list into unique vertices.
+ *
+ * @param triangles A triangle list of VERTEX_FLOATS floats per vertex.
+ * @param vertices The unique vertices, in the same layout.
+ * @param indices Three indices into vertices per triangle.
+ */
+void indexMesh(const std::vector<float> &triangles, std::vector<float> &vertices, std::vector<uint32_t> &indices);
+
+/**
+ * Reorders the triangles so their vertices are found in the post-transform
+ * cache as often as possible, with Tom Forsyth's linear-speed algorithm.
+ * Each vertex is scored by how recently it was used and how few triangles
+ * it has left, and the triangle with the best vertices is emitted next.
+ */
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+/**
+ * Splits the cache ordered triangles into clusters where the cache starts
+ * afresh, and draws the clusters facing out from the middle of the mesh
+ * first, so they hide those behind them. The order within each cluster is
+ * kept, so little of the cache optimisation is lost.
+ */
+void optimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<float> &vertices);
+
+/**
+ * Reorders the vertices into the order the triangles first use them,
+ * so they are fetched from memory in sequence, dropping any unused.
+ */
+void optimizeVertexFetch(std::vector<float> &vertices, std::vector<uint32_t> &indices);
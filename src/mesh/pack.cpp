@@ -0,0 +1,48 @@
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "pack.hpp"
+
+/**
+ * Maps a unit vector onto the octahedron, then folds the lower half over the upper
+ * so it fits a square, matching octDecode in vertex_fish.glsl and vertex_speaker.glsl.
+ */
+static glm::vec2 octEncode(glm::vec3 d) {
+    d /= std::abs(d.x) + std::abs(d.y) + std::abs(d.z);
+    if (d.z >= 0.0f) return glm::vec2(d.x, d.y);
+    return glm::vec2((1.0f - std::abs(d.y)) * (d.x >= 0.0f ? 1.0f : -1.0f),
+                     (1.0f - std::abs(d.x)) * (d.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+static glm::vec3 octDecode(glm::vec2 p) {
+    glm::vec3 d(p, 1.0f - std::abs(p.x) - std::abs(p.y));
+    if (d.z < 0.0f) {
+        const glm::vec2 folded = 1.0f - glm::abs(glm::vec2(d.y, d.x));
+        d.x = folded.x * (d.x >= 0.0f ? 1.0f : -1.0f);
+        d.y = folded.y * (d.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(d);
+}
+
+packed_vertex packVertex(const float *vertex) {
+    packed_vertex packed{};
+    for (int i = 0; i < 3; i++) packed.position[i] = glm::packHalf1x16(vertex[i]);
+
+    const glm::vec3 normal(vertex[3], vertex[4], vertex[5]);
+    const glm::vec2 encoded = octEncode(glm::length(normal) > 0.0f ? normal : glm::vec3(0.0f, 0.0f, 1.0f));
+    for (int i = 0; i < 2; i++) {
+        packed.normal[i] = (int16_t) std::lround(glm::clamp(encoded[i], -1.0f, 1.0f) * 32767.0f);
+        packed.texcoord[i] = (uint16_t) std::lround(glm::clamp(vertex[6 + i], 0.0f, 1.0f) * 65535.0f);
+    }
+    return packed;
+}
+
+void unpackVertex(const packed_vertex &packed, float *vertex) {
+    for (int i = 0; i < 3; i++) vertex[i] = glm::unpackHalf1x16(packed.position[i]);
+
+    const glm::vec3 normal = octDecode(glm::vec2(packed.normal[0], packed.normal[1]) / 32767.0f);
+    for (int i = 0; i < 3; i++) vertex[3 + i] = normal[i];
+    for (int i = 0; i < 2; i++) vertex[6 + i] = (float) packed.texcoord[i] / 65535.0f;
+}
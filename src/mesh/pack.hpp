@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * A vertex as it is stored in the geometry pool, and in baked meshes:
+ * the position as half floats, the normal octahedral encoded as two
+ * snorm16s, and the texture coordinate as two unorm16s, so texture
+ * coordinates must lie within [0, 1].
+ */
+struct packed_vertex {
+    uint16_t position[4]; // half floats, the last is padding
+    int16_t normal[2]; // octahedral encoded snorm
+    uint16_t texcoord[2]; // unorm
+};
+
+static_assert(sizeof(packed_vertex) == 16, "packed_vertex must match the attribute offsets in the geometry pool");
+
+/**
+ * Packs a vertex of VERTEX_FLOATS floats.
+ */
+packed_vertex packVertex(const float *vertex);
+
+/**
+ * Unpacks a vertex into VERTEX_FLOATS floats.
+ */
+void unpackVertex(const packed_vertex &packed, float *vertex);
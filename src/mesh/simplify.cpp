@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <array>
+#include <map>
+#include <queue>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "simplify.hpp"
+
+// the extra weight given to the planes which keep open edges in place
+#define BOUNDARY_WEIGHT 100.0
+
+/**
+ * The sum of squared distances to a set of planes,
+ * stored as the upper triangle of a symmetric 4x4 matrix.
+ */
+struct quadric {
+    std::array<double, 10> q{};
+
+    static quadric plane(glm::dvec3 normal, double d, double weight) {
+        const double a = normal.x, b = normal.y, c = normal.z;
+        return {{
+                weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+                weight * b * b, weight * b * c, weight * b * d,
+                weight * c * c, weight * c * d,
+                weight * d * d,
+        }};
+    }
+
+    quadric &operator+=(const quadric &other) {
+        for (size_t i = 0; i < q.size(); i++) q[i] += other.q[i];
+        return *this;
+    }
+
+    double error(glm::dvec3 v) const {
+        return q[0] * v.x * v.x + 2 * q[1] * v.x * v.y + 2 * q[2] * v.x * v.z + 2 * q[3] * v.x
+               + q[4] * v.y * v.y + 2 * q[5] * v.y * v.z + 2 * q[6] * v.y
+               + q[7] * v.z * v.z + 2 * q[8] * v.z
+               + q[9];
+    }
+};
+
+/**
+ * A candidate collapse of one vertex onto another, along with
+ * the versions of both when it was costed so stale ones are skipped.
+ */
+struct collapse {
+    double cost;
+    uint32_t from, to;
+    uint32_t fromVersion, toVersion;
+
+    bool operator>(const collapse &other) const { return cost > other.cost; }
+};
+
+struct triangle {
+    std::array<uint32_t, 3> positions; // welded position indices
+    std::array<uint32_t, 3> corners; // the original vertices, for their normals and texture coordinates
+    bool removed;
+};
+
+/**
+ * The mesh being simplified, with its positions welded
+ * and the triangles around each position.
+ */
+struct simplifier {
+    std::vector<glm::dvec3> positions;
+    std::vector<quadric> quadrics;
+    std::vector<std::vector<uint32_t>> adjacent;
+    std::vector<uint32_t> versions;
+    std::vector<bool> removed;
+    std::vector<triangle> triangles;
+    std::priority_queue<collapse, std::vector<collapse>, std::greater<>> queue;
+
+    void push(uint32_t from, uint32_t to) {
+        quadric combined = quadrics[from];
+        combined += quadrics[to];
+        queue.push({combined.error(positions[to]), from, to, versions[from], versions[to]});
+    }
+
+    /**
+     * Checks that moving a position onto another won't turn any triangle around it over.
+     */
+    bool flips(uint32_t from, uint32_t to) const {
+        for (uint32_t t : adjacent[from]) {
+            const triangle &tri = triangles[t];
+            if (tri.removed) continue;
+            if (tri.positions[0] == to || tri.positions[1] == to || tri.positions[2] == to) continue;
+
+            std::array<glm::dvec3, 3> before{}, after{};
+            for (size_t i = 0; i < 3; i++) {
+                before[i] = positions[tri.positions[i]];
+                after[i] = tri.positions[i] == from ? positions[to] : before[i];
+            }
+
+            glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normalBefore, normalAfter) <= 0.0) return true;
+        }
+        return false;
+    }
+
+    /**
+     * Moves a position onto another, removing the triangles which collapse.
+     * @return The number of triangles removed.
+     */
+    size_t apply(uint32_t from, uint32_t to) {
+        size_t collapsed = 0;
+        for (uint32_t t : adjacent[from]) {
+            triangle &tri = triangles[t];
+            if (tri.removed) continue;
+
+            if (tri.positions[0] == to || tri.positions[1] == to || tri.positions[2] == to) {
+                tri.removed = true;
+                collapsed++;
+                continue;
+            }
+
+            for (auto &p : tri.positions) if (p == from) p = to;
+            adjacent[to].push_back(t);
+        }
+
+        quadrics[to] += quadrics[from];
+        removed[from] = true;
+        adjacent[from].clear();
+        versions[to]++;
+
+        // drop the removed triangles and queue up the new edges around the survivor
+        auto &around = adjacent[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return triangles[t].removed; }),
+                     around.end());
+        for (uint32_t t : around) {
+            for (uint32_t p : triangles[t].positions) {
+                if (p == to) continue;
+                push(to, p);
+                push(p, to);
+            }
+        }
+
+        return collapsed;
+    }
+};
+
+std::vector<float> simplifyMesh(const std::vector<float> &vertices, size_t targetTriangles) {
+    simplifier mesh;
+
+    // weld the positions so the triangles share edges
+    std::map<std::array<float, 3>, uint32_t> welded;
+    std::vector<uint32_t> vertexPositions;
+    const size_t vertexCount = vertices.size() / VERTEX_FLOATS;
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float *vertex = &vertices[v * VERTEX_FLOATS];
+        auto found = welded.emplace(std::array<float, 3>{vertex[0], vertex[1], vertex[2]}, mesh.positions.size());
+        if (found.second) mesh.positions.emplace_back(vertex[0], vertex[1], vertex[2]);
+        vertexPositions.push_back(found.first->second);
+    }
+
+    const size_t positionCount = mesh.positions.size();
+    mesh.quadrics.resize(positionCount);
+    mesh.adjacent.resize(positionCount);
+    mesh.versions.resize(positionCount);
+    mesh.removed.resize(positionCount);
+
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edgeUses;
+    for (size_t t = 0; t < vertexCount / 3; t++) {
+        triangle tri{};
+        for (size_t i = 0; i < 3; i++) {
+            tri.positions[i] = vertexPositions[t * 3 + i];
+            tri.corners[i] = (uint32_t) (t * 3 + i);
+        }
+
+        // skip triangles which welding made degenerate
+        if (tri.positions[0] == tri.positions[1] || tri.positions[1] == tri.positions[2] ||
+            tri.positions[0] == tri.positions[2]) {
+            continue;
+        }
+
+        const auto t0 = (uint32_t) mesh.triangles.size();
+        mesh.triangles.push_back(tri);
+
+        // each triangle's plane, weighted by its area
+        const glm::dvec3 &a = mesh.positions[tri.positions[0]];
+        glm::dvec3 normal = glm::cross(mesh.positions[tri.positions[1]] - a, mesh.positions[tri.positions[2]] - a);
+        const double area = glm::length(normal);
+        if (area > 0.0) normal /= area;
+        const quadric plane = quadric::plane(normal, -glm::dot(normal, a), area);
+
+        for (size_t i = 0; i < 3; i++) {
+            const uint32_t p = tri.positions[i], next = tri.positions[(i + 1) % 3];
+            mesh.quadrics[p] += plane;
+            mesh.adjacent[p].push_back(t0);
+            edgeUses[{std::min(p, next), std::max(p, next)}]++;
+        }
+    }
+
+    // keep open edges from shrinking inwards with a plane through each, perpendicular to its triangle
+    for (const triangle &tri : mesh.triangles) {
+        const glm::dvec3 &a = mesh.positions[tri.positions[0]];
+        const glm::dvec3 faceNormal = glm::cross(mesh.positions[tri.positions[1]] - a, mesh.positions[tri.positions[2]] - a);
+        for (size_t i = 0; i < 3; i++) {
+            const uint32_t p = tri.positions[i], next = tri.positions[(i + 1) % 3];
+            if (edgeUses[{std::min(p, next), std::max(p, next)}] != 1) continue;
+
+            const glm::dvec3 edge = mesh.positions[next] - mesh.positions[p];
+            glm::dvec3 normal = glm::cross(edge, faceNormal);
+            const double length = glm::length(normal);
+            if (length == 0.0) continue;
+            normal /= length;
+
+            const quadric plane = quadric::plane(normal, -glm::dot(normal, mesh.positions[p]),
+                                                 BOUNDARY_WEIGHT * glm::dot(edge, edge));
+            mesh.quadrics[p] += plane;
+            mesh.quadrics[next] += plane;
+        }
+    }
+
+    for (const auto &edge : edgeUses) {
+        mesh.push(edge.first.first, edge.first.second);
+        mesh.push(edge.first.second, edge.first.first);
+    }
+
+    size_t remaining = mesh.triangles.size();
+    while (remaining > targetTriangles && !mesh.queue.empty()) {
+        const collapse next = mesh.queue.top();
+        mesh.queue.pop();
+
+        if (mesh.removed[next.from] || mesh.removed[next.to]) continue;
+        if (mesh.versions[next.from] != next.fromVersion || mesh.versions[next.to] != next.toVersion) continue;
+        if (mesh.flips(next.from, next.to)) continue;
+
+        remaining -= mesh.apply(next.from, next.to);
+    }
+
+    // write out the surviving triangles, with each corner keeping its own attributes
+    std::vector<float> simplified;
+    simplified.reserve(remaining * 3 * VERTEX_FLOATS);
+    for (const triangle &tri : mesh.triangles) {
+        if (tri.removed) continue;
+        for (size_t i = 0; i < 3; i++) {
+            const glm::dvec3 &p = mesh.positions[tri.positions[i]];
+            const float *corner = &vertices[tri.corners[i] * VERTEX_FLOATS];
+            simplified.push_back((float) p.x);
+            simplified.push_back((float) p.y);
+            simplified.push_back((float) p.z);
+            simplified.insert(simplified.end(), corner + 3, corner + VERTEX_FLOATS);
+        }
+    }
+    return simplified;
+}
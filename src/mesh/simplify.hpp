@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+#define VERTEX_FLOATS 8 // position, normal, then texture coordinate
+
+/**
+ * Reduces a mesh using quadric error metrics, collapsing the cheapest
+ * edges first until the target is reached or no edge can be collapsed
+ * without folding a triangle over.
+ *
+ * Positions are welded before simplifying, but normals and texture
+ * coordinates stay with the corners of the surviving triangles, so
+ * seams in the texture are kept.
+ *
+ * @param vertices A triangle list of VERTEX_FLOATS floats per vertex.
+ * @param targetTriangles The number of triangles to reduce to.
+ * @return The simplified triangle list, in the same layout.
+ */
+std::vector<float> simplifyMesh(const std::vector<float> &vertices, size_t targetTriangles);
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "program_cache.hpp"
+
+/**
+ * The start of a saved binary, which is followed by the binary itself.
+ */
+struct program_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key; // checked against the name, in case the file was renamed or cut short
+    uint32_t binaryFormat;
+    uint32_t length;
+};
+
+// FNV-1a, see http://www.isthe.com/chongo/tech/comp/fnv/
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static std::string glString(GLenum name) {
+    const auto *value = reinterpret_cast<const char *>(glGetString(name));
+    return value ? value : "";
+}
+
+program_cache::program_cache() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    this->supported = formats > 0;
+    this->driver = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+
+    std::error_code error;
+    if (this->supported) std::filesystem::create_directories(PROGRAM_CACHE_DIRECTORY, error);
+}
+
+uint64_t program_cache::key(const std::vector<program_source> &stages) const {
+    const uint32_t version = PROGRAM_CACHE_VERSION;
+    uint64_t hash = hashBytes(FNV_OFFSET, &version, sizeof(version));
+    hash = hashBytes(hash, this->driver.data(), this->driver.size() + 1);
+    for (const program_source &stage : stages) {
+        hash = hashBytes(hash, &stage.type, sizeof(stage.type));
+        hash = hashBytes(hash, stage.code.data(), stage.code.size() + 1);
+    }
+    return hash;
+}
+
+std::string program_cache::pathOf(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+    return std::string(PROGRAM_CACHE_DIRECTORY) + "/" + name;
+}
+
+bool program_cache::load(uint64_t key, GLuint program) {
+    if (!this->supported) return false;
+
+    const std::string path = this->pathOf(key);
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) return false;
+    const std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    program_header header{};
+    if (bytes.size() >= sizeof(header)) std::memcpy(&header, bytes.data(), sizeof(header));
+
+    // a program which fails to load a binary can still be linked from source afterwards
+    GLint status = GL_FALSE;
+    if (header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION && header.key == key
+        && bytes.size() == sizeof(header) + header.length) {
+        glProgramBinary(program, header.binaryFormat, bytes.data() + sizeof(header), (GLsizei) header.length);
+        // a driver update can reject a binary even with the same version string
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+    }
+
+    std::error_code error;
+    if (status == GL_FALSE) std::filesystem::remove(path, error);
+    return status != GL_FALSE;
+}
+
+void program_cache::store(uint64_t key, GLuint program) {
+    if (!this->supported) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    program_header header{PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, key, 0, 0};
+    std::vector<char> binary((size_t) length);
+    GLenum binaryFormat;
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+    header.binaryFormat = binaryFormat;
+    header.length = (uint32_t) length;
+
+    // written beside it then moved over, so another launch never reads half a binary
+    const std::string path = this->pathOf(key);
+    const std::string partial = path + ".partial";
+    {
+        std::ofstream file(partial, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), header.length);
+        if (!file.good()) return;
+    }
+    std::error_code error;
+    std::filesystem::rename(partial, path, error);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <glad/glad.h>
+
+#define PROGRAM_CACHE_DIRECTORY "shader_cache" // where the binaries are kept, beside the shaders
+#define PROGRAM_CACHE_MAGIC 0x47505341u // "ASPG", read little endian
+#define PROGRAM_CACHE_VERSION 1 // bumped whenever the layout changes, so old binaries are ignored
+
+/**
+ * The source of one stage of a program.
+ */
+struct program_source {
+    GLenum type;
+    std::string path;
+    std::string code;
+};
+
+/**
+ * Linked programs saved to disk with glGetProgramBinary, so later launches
+ * load them with glProgramBinary rather than compiling the sources again.
+ *
+ * Each binary is keyed by a hash of the sources of every stage, including
+ * any defines written into them, along with the vendor, renderer and
+ * version of the driver, which a binary is only valid for. A binary which
+ * doesn't match its key, or which the driver rejects, is deleted and the
+ * program built from source instead. Where the driver has no binary
+ * formats the cache does nothing.
+ */
+class program_cache {
+public:
+    static program_cache &getInstance() {
+        static program_cache instance;
+        return instance;
+    }
+
+    program_cache(program_cache const &) = delete;
+
+    void operator=(program_cache const &) = delete;
+
+    /**
+     * Hashes the stages of a program together with the driver.
+     */
+    uint64_t key(const std::vector<program_source> &stages) const;
+
+    /**
+     * Loads a program's saved binary into it.
+     * @returns Whether it was linked, if not it has to be built from source.
+     */
+    bool load(uint64_t key, GLuint program);
+
+    /**
+     * Saves the binary of a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+     */
+    void store(uint64_t key, GLuint program);
+
+private:
+    std::string driver; // the vendor, renderer and version the binaries are for
+    bool supported;
+
+    program_cache();
+
+    std::string pathOf(uint64_t key) const;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stddef.h>
+
+/**
+ * A fixed-capacity, lock-free queue for exactly one producer and one consumer.
+ * Pushing never allocates, so it is safe to use from callbacks.
+ *
+ * @tparam T The type of item to store.
+ * @tparam Capacity The number of slots, which must be a power of two.
+ */
+template<typename T, size_t Capacity>
+class ring_buffer {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+    std::array<T, Capacity> items;
+    alignas(64) std::atomic<size_t> head{0}; // the next slot to read, only written by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // the next slot to write, only written by the producer
+public:
+    /**
+     * Adds an item to the back of the queue.
+     * @returns False if the queue was full and the item was dropped.
+     */
+    bool push(const T &item) {
+        auto write = tail.load(std::memory_order_relaxed);
+        if (write - head.load(std::memory_order_acquire) == Capacity) return false;
+        items[write & (Capacity - 1)] = item;
+        tail.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the item from the front of the queue.
+     * @returns False if the queue was empty.
+     */
+    bool pop(T &item) {
+        auto read = head.load(std::memory_order_relaxed);
+        if (read == tail.load(std::memory_order_acquire)) return false;
+        item = items[read & (Capacity - 1)];
+        head.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
@@ -2,4 +2,60 @@
 // Created by Alexander Lyon on 2019-10-16.
 //
 
+#include <atomic>
+
 #include "settings.hpp"
+
+/**
+ * Works out which groups of settings differ between two sets of values.
+ */
+static uint32_t changedGroups(const settings_values &a, const settings_values &b) {
+    uint32_t changed = 0;
+    if (a.fov != b.fov || a.mouse_sensitivity != b.mouse_sensitivity) {
+        changed |= SETTINGS_CAMERA;
+    }
+    if (a.enable_menu != b.enable_menu || a.fish != b.fish || a.color != b.color || a.time_scale != b.time_scale ||
+        a.quantized_instances != b.quantized_instances ||
+        a.impostors != b.impostors || a.baked_animation != b.baked_animation || a.gpu_culling != b.gpu_culling ||
+        a.upload_budget != b.upload_budget) {
+        changed |= SETTINGS_SCENE;
+    }
+    if (a.group_size != b.group_size || a.boid_avoid != b.boid_avoid ||
+        a.min_boid_distance != b.min_boid_distance || a.min_camera_distance != b.min_camera_distance) {
+        changed |= SETTINGS_BOIDS;
+    }
+    if (a.compact_fish != b.compact_fish) {
+        changed |= SETTINGS_STORAGE;
+    }
+    return changed;
+}
+
+Settings::Settings() {
+    auto initial = std::make_shared<settings_snapshot>();
+    initial->version = 1;
+    this->current = initial;
+}
+
+void Settings::publish() {
+    auto previous = this->snapshot();
+    uint32_t changed = changedGroups(*previous, *this);
+    if (changed == 0) return;
+
+    auto next = std::make_shared<settings_snapshot>();
+    static_cast<settings_values &>(*next) = *this;
+    next->version = previous->version + 1;
+    next->changed = changed;
+    std::atomic_store(&this->current, std::shared_ptr<const settings_snapshot>(next));
+
+    for (auto &[groups, listener] : this->listeners) {
+        if (groups & changed) listener(*next);
+    }
+}
+
+std::shared_ptr<const settings_snapshot> Settings::snapshot() const {
+    return std::atomic_load(&this->current);
+}
+
+void Settings::subscribe(uint32_t groups, std::function<void(const settings_snapshot &)> listener) {
+    this->listeners.emplace_back(groups, std::move(listener));
+}
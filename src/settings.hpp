@@ -5,20 +5,28 @@
 # pragma once
 
 #include <stdint.h>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include <glm/glm.hpp>
 
-class Settings {
-public:
-    static Settings &getInstance() {
-        static Settings instance;
-        return instance;
-    }
-
-    Settings(Settings const &) = delete;
-
-    void operator=(Settings const &) = delete;
+/**
+ * The groups of settings, used to tell which
+ * parts of a snapshot changed since the last one.
+ */
+enum settings_group : uint32_t {
+    SETTINGS_CAMERA = 1u << 0u,
+    SETTINGS_SCENE = 1u << 1u,
+    SETTINGS_BOIDS = 1u << 2u,
+    SETTINGS_STORAGE = 1u << 3u, // how the fish are stored, which means converting every one
+    SETTINGS_ALL = ~0u,
+};
 
+/**
+ * The user-tweakable values.
+ */
+struct settings_values {
     bool enable_menu = false;
 
     // camera
@@ -29,13 +37,62 @@ public:
     int fish = 50;
     glm::vec3 color = glm::vec3(0.1f, 0.12f, 0.33f);
     float time_scale = 1.0f;
+    bool compact_fish = false; // store fish positions and velocities quantized
+    bool quantized_instances = false; // upload fish instances as 16-bit values
+    bool impostors = true; // draw distant fish as billboards
+    bool baked_animation = true; // look up the swim cycle of less detailed fish from a texture
+    bool gpu_culling = true; // cull the fish in a compute shader, where there are compute shaders
+    int upload_budget = 4096; // the kilobytes of loaded models and textures copied to the gpu each frame
 
     // boids
     int group_size = 10;
     int boid_avoid = 10;
     float min_boid_distance = 10;
     float min_camera_distance = 10;
+};
+
+/**
+ * An immutable copy of the settings, published once per frame.
+ * Systems read this instead of the live values, which the menu
+ * may be writing to at the same time.
+ */
+struct settings_snapshot : settings_values {
+    uint64_t version = 0; // incremented whenever a value changes
+    uint32_t changed = SETTINGS_ALL; // the groups which differ from the previous snapshot
+};
+
+class Settings : public settings_values {
+public:
+    static Settings &getInstance() {
+        static Settings instance;
+        return instance;
+    }
+
+    Settings(Settings const &) = delete;
+
+    void operator=(Settings const &) = delete;
+
+    /**
+     * Publishes the live values as a new snapshot if any of them changed,
+     * notifying the listeners subscribed to the groups that did.
+     * @note Should only be called from the main thread, once per frame.
+     */
+    void publish();
+
+    /**
+     * Gets the latest published snapshot. Safe to call from any thread.
+     */
+    std::shared_ptr<const settings_snapshot> snapshot() const;
+
+    /**
+     * Registers a callback, run on the main thread whenever
+     * a snapshot changing any of the given groups is published.
+     */
+    void subscribe(uint32_t groups, std::function<void(const settings_snapshot &)> listener);
 
 private:
-    Settings() = default;
+    Settings();
+
+    std::shared_ptr<const settings_snapshot> current;
+    std::vector<std::pair<uint32_t, std::function<void(const settings_snapshot &)>>> listeners;
 };
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <iostream>
+
+#include "shader_compiler.hpp"
+#include "components/render.hpp"
+
+shader_compiler::~shader_compiler() {
+    this->close();
+}
+
+void shader_compiler::open(GLFWwindow *window) {
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(SHADER_COMPILER_THREADS);
+        this->parallel = true;
+        return;
+    }
+
+    // the worker's window is never shown, it only needs a context sharing the window's objects
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    this->context = glfwCreateWindow(1, 1, "", nullptr, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (this->context) this->worker = std::thread(&shader_compiler::run, this);
+}
+
+std::shared_ptr<compiled_program> shader_compiler::compile(std::vector<program_source> stages) {
+    program_cache &cache = program_cache::getInstance();
+    auto program = std::make_shared<compiled_program>();
+    program->id = glCreateProgram();
+    const uint64_t key = cache.key(stages);
+
+    // a saved binary is quick enough to load that it's used right away
+    if (cache.load(key, program->id)) {
+        introspect(*program);
+        program->linked = true;
+        return program;
+    }
+    this->queued.push_back({program, std::move(stages), key, {}, {}});
+    this->waiting++;
+    return program;
+}
+
+void shader_compiler::issue(compile_job &job) {
+    for (const program_source &stage : job.stages) {
+        GLuint shaderID = glCreateShader(stage.type);
+        char const *sourcePointer = stage.code.c_str();
+        glShaderSource(shaderID, 1, &sourcePointer, nullptr);
+        glCompileShader(shaderID);
+        glAttachShader(job.target->id, shaderID);
+        job.shaders.push_back(shaderID);
+    }
+
+    // ask for a binary the program cache can save
+    glProgramParameteri(job.target->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(job.target->id);
+}
+
+/**
+ * Reads the info log of a shader or program.
+ */
+template<typename GetLength, typename GetLog>
+static std::string infoLog(GLuint id, GetLength getLength, GetLog getLog) {
+    GLint length = 0;
+    getLength(id, GL_INFO_LOG_LENGTH, &length);
+    std::vector<GLchar> log((size_t) std::max(length, 1));
+    getLog(id, (GLsizei) log.size(), nullptr, log.data());
+    return log.data();
+}
+
+void shader_compiler::collect(compile_job &job) {
+    GLint status;
+    glGetProgramiv(job.target->id, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        for (size_t i = 0; i < job.shaders.size(); i++) {
+            glGetShaderiv(job.shaders[i], GL_COMPILE_STATUS, &status);
+            if (status == GL_TRUE) continue;
+            job.error += "Errors when compiling " + job.stages[i].path + ".\n";
+            job.error += infoLog(job.shaders[i], glGetShaderiv, glGetShaderInfoLog) + "\n";
+        }
+        job.error += infoLog(job.target->id, glGetProgramiv, glGetProgramInfoLog);
+    }
+
+    for (auto shaderID : job.shaders) {
+        glDetachShader(job.target->id, shaderID);
+        glDeleteShader(shaderID);
+    }
+    job.shaders.clear();
+}
+
+/**
+ * Finds the uniforms of a newly linked program, and points its frame block and samplers at their bindings.
+ */
+void shader_compiler::introspect(compiled_program &program) {
+    // look up every uniform now rather than by name on every set, arrays are
+    // reported by their first element so their locations are stored under both
+    GLint uniformCount, nameLength;
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &nameLength);
+    std::vector<GLchar> name((size_t) std::max(nameLength, 1));
+    for (GLint i = 0; i < uniformCount; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program.id, (GLuint) i, (GLsizei) name.size(), nullptr, &size, &type, name.data());
+        const GLint uniformLocation = glGetUniformLocation(program.id, name.data());
+        if (uniformLocation < 0) continue; // members of uniform blocks have no location
+
+        std::string uniformName(name.data());
+        program.uniforms[uniformName] = uniformLocation;
+        const size_t subscript = uniformName.rfind("[0]");
+        if (subscript != std::string::npos && subscript == uniformName.size() - 3) {
+            program.uniforms[uniformName.substr(0, subscript)] = uniformLocation;
+        }
+    }
+
+    // 4.1 has no binding layout qualifier, so the frame block and samplers are pointed at theirs here,
+    // through the program itself so whichever is in use stays bound
+    const GLuint frameBlock = glGetUniformBlockIndex(program.id, "frame_data");
+    if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(program.id, frameBlock, FRAME_UNIFORM_BINDING);
+    const std::pair<const char *, GLint> samplers[] = {
+            {"diffuse", UNIT_DIFFUSE},
+            {"roughness", UNIT_ROUGHNESS},
+            {"metallic", UNIT_METALLIC},
+            {"instanceAttributes", UNIT_INSTANCE_ATTRIBUTES},
+            {"impostorAlbedo", UNIT_IMPOSTOR_ALBEDO},
+            {"impostorNormal", UNIT_IMPOSTOR_NORMAL},
+            {"swimAnimation", UNIT_SWIM_ANIMATION},
+            {"diffuseHues", UNIT_DIFFUSE_HUES},
+    };
+    for (const auto &sampler : samplers) {
+        auto found = program.uniforms.find(sampler.first);
+        if (found != program.uniforms.end()) glProgramUniform1i(program.id, found->second, sampler.second);
+    }
+}
+
+void shader_compiler::run() {
+    glfwMakeContextCurrent(this->context);
+    for (;;) {
+        compile_job job;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+            if (this->stopping) break;
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+
+        // the program has to be complete before the GL thread can use it from its own context
+        issue(job);
+        glFinish();
+        collect(job);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->finished.push_back(std::move(job));
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+void shader_compiler::update() {
+    // everything queued since the last update goes out together
+    if (this->parallel) {
+        for (compile_job &job : this->queued) {
+            issue(job);
+            this->compiling.push_back(std::move(job));
+        }
+    } else if (this->context) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            for (compile_job &job : this->queued) this->jobs.push_back(std::move(job));
+        }
+        this->wake.notify_one();
+    } else {
+        for (compile_job &job : this->queued) {
+            issue(job);
+            collect(job);
+            this->finish(job);
+        }
+    }
+    this->queued.clear();
+
+    if (this->parallel) {
+        // only a program the driver reports complete can be checked without waiting on it
+        for (size_t i = 0; i < this->compiling.size();) {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(this->compiling[i].target->id, GL_COMPLETION_STATUS_KHR, &complete);
+            if (complete == GL_FALSE) {
+                i++;
+                continue;
+            }
+            collect(this->compiling[i]);
+            this->finish(this->compiling[i]);
+            this->compiling.erase(this->compiling.begin() + (long) i);
+        }
+    } else if (this->context) {
+        std::deque<compile_job> done;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            done.swap(this->finished);
+        }
+        for (compile_job &job : done) this->finish(job);
+    }
+}
+
+/**
+ * Reports a program which failed, or saves one which linked and lets it be drawn with.
+ */
+void shader_compiler::finish(compile_job &job) {
+    if (!job.error.empty()) {
+        std::cerr << job.error << std::endl;
+        std::exit(1);
+    }
+
+    program_cache::getInstance().store(job.key, job.target->id);
+    introspect(*job.target);
+    job.target->linked = true;
+    this->waiting--;
+}
+
+size_t shader_compiler::pending() const {
+    return this->waiting;
+}
+
+void shader_compiler::close() {
+    if (!this->context) return;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    if (this->worker.joinable()) this->worker.join();
+    glfwDestroyWindow(this->context);
+    this->context = nullptr;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "program_cache.hpp"
+
+#define SHADER_COMPILER_THREADS 0xFFFFFFFFu // how many threads the driver may compile on, as many as it likes
+
+/**
+ * A program being built in the background, shared between the copies of its shader.
+ */
+struct compiled_program {
+    GLuint id; // made up front, so the program can be sorted by before it has linked
+    bool linked = false; // set on the GL thread once it has been introspected and can be drawn with
+    std::unordered_map<std::string, GLint> uniforms; // the location of each active uniform, found once it has linked
+};
+
+/**
+ * Compiles and links shader programs without holding up the frame.
+ *
+ * Programs are queued as their shaders are made, then everything queued
+ * is sent off together on the next update. Where the driver supports
+ * GL_KHR_parallel_shader_compile, it compiles them on its own threads and
+ * each update polls GL_COMPLETION_STATUS_KHR to find those done. Otherwise
+ * they go to a thread of our own with a hidden context sharing the
+ * window's, and failing that they're built on the GL thread in the update.
+ *
+ * A program with a binary in the program cache is linked straight away,
+ * and those built from source are saved to it once they've linked.
+ * Either way its uniforms are looked up before it's marked as linked.
+ */
+class shader_compiler {
+public:
+    static shader_compiler &getInstance() {
+        static shader_compiler instance;
+        return instance;
+    }
+
+    shader_compiler(shader_compiler const &) = delete;
+
+    void operator=(shader_compiler const &) = delete;
+
+    ~shader_compiler();
+
+    /**
+     * Picks how programs will be compiled, making the worker's context if it's needed.
+     * @note Should be called from the GL thread, once the window's context is current.
+     */
+    void open(GLFWwindow *window);
+
+    /**
+     * Queues a program to be built from the given stages.
+     * @returns The program, which mustn't be used until it has linked.
+     * @note Should only be called from the GL thread.
+     */
+    std::shared_ptr<compiled_program> compile(std::vector<program_source> stages);
+
+    /**
+     * Sends off everything queued since the last update, and marks any
+     * programs which have finished as linked.
+     * @note Should only be called from the GL thread, once per frame.
+     */
+    void update();
+
+    /**
+     * The programs queued which haven't linked yet.
+     */
+    size_t pending() const;
+
+    void close();
+
+private:
+    struct compile_job {
+        std::shared_ptr<compiled_program> target;
+        std::vector<program_source> stages;
+        uint64_t key;
+        std::vector<GLuint> shaders; // the compiled stages, until the program has linked
+        std::string error; // the logs of whatever failed, if it did
+    };
+
+    GLFWwindow *context = nullptr; // the worker's hidden window
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake; // signalled when jobs are handed to the worker
+    std::deque<compile_job> jobs; // handed to the worker
+    std::deque<compile_job> finished; // linked by the worker, not yet picked up
+    bool stopping = false;
+
+    std::vector<compile_job> queued; // waiting for the next update, owned by the GL thread
+    std::vector<compile_job> compiling; // sent to the driver's threads
+    size_t waiting = 0; // the programs queued which haven't linked yet
+    bool parallel = false;
+
+    shader_compiler() = default;
+
+    static void issue(compile_job &job);
+
+    static void collect(compile_job &job);
+
+    static void introspect(compiled_program &program);
+
+    void run();
+
+    void finish(compile_job &job);
+};
@@ -0,0 +1,116 @@
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include "kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86
+#endif
+
+namespace simd {
+
+enum class isa {
+    scalar,
+    sse42,
+    avx2,
+    avx512,
+};
+
+/**
+ * Works out the widest instruction set supported by both the cpu and the os.
+ */
+static isa detect() {
+#if defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    // the os must save the ymm (and zmm) registers on context switches
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    bool avx2 = false;
+    bool avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = ymm && (info[1] & (1 << 5)) != 0;
+        avx512 = zmm && (info[1] & (1 << 16)) != 0;
+    }
+
+    if (avx512) return isa::avx512;
+    if (avx2) return isa::avx2;
+    if (sse42) return isa::sse42;
+    return isa::scalar;
+#elif defined(SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return isa::avx512;
+    if (__builtin_cpu_supports("avx2")) return isa::avx2;
+    if (__builtin_cpu_supports("sse4.2")) return isa::sse42;
+    return isa::scalar;
+#else
+    return isa::scalar;
+#endif
+}
+
+static const kernel_table *select() {
+    isa supported = detect();
+
+    // allow forcing a narrower path, for testing on wide machines
+    if (const char *forced = std::getenv("AQUARIUM_SIMD")) {
+        isa cap = supported;
+        if (std::strcmp(forced, "scalar") == 0) cap = isa::scalar;
+        else if (std::strcmp(forced, "sse42") == 0) cap = isa::sse42;
+        else if (std::strcmp(forced, "avx2") == 0) cap = isa::avx2;
+        if (cap < supported) supported = cap;
+    }
+
+    struct candidate {
+        isa level;
+        const kernel_table *(*table)();
+    };
+    const candidate candidates[] = {
+            {isa::avx512, avx512::table},
+            {isa::avx2,   avx2::table},
+            {isa::sse42,  sse42::table},
+    };
+
+    for (const auto &c : candidates) {
+        if (c.level > supported) continue;
+        if (const kernel_table *table = c.table()) return table;
+    }
+    return scalar::table();
+}
+
+const kernel_table &kernels() {
+    static const kernel_table &selected = *select();
+    return selected;
+}
+
+void flock_buffer::resize(size_t count) {
+    for (auto *array : {&px, &py, &pz, &qx, &qy, &qz, &qw, &vx, &vy, &vz}) array->resize(count);
+    group.resize(count);
+    slot.resize(count);
+}
+
+flock_arrays flock_buffer::arrays(size_t first) {
+    return {
+            px.data() + first, py.data() + first, pz.data() + first,
+            qx.data() + first, qy.data() + first, qz.data() + first, qw.data() + first,
+            vx.data() + first, vy.data() + first, vz.data() + first,
+            group.data() + first,
+            slot.data() + first,
+            group.size() - first,
+    };
+}
+
+}
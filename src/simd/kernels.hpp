@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace simd {
+
+/**
+ * Pointers to the fish data, laid out as a structure of arrays.
+ * Kernels only touch the arrays they need, the rest may be null.
+ */
+struct flock_arrays {
+    float *px, *py, *pz; // position
+    float *qx, *qy, *qz, *qw; // orientation
+    float *vx, *vy, *vz; // velocity
+    int32_t *group;
+    int32_t *slot; // the instance slot each fish is drawn from
+    size_t count;
+};
+
+/**
+ * Staging storage for the arrays above, which the
+ * systems fill from the registry and reuse every frame.
+ */
+struct flock_buffer {
+    std::vector<float> px, py, pz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> vx, vy, vz;
+    std::vector<int32_t> group;
+    std::vector<int32_t> slot;
+
+    void resize(size_t count);
+
+    /**
+     * Gets the arrays, starting from the given element.
+     */
+    flock_arrays arrays(size_t first = 0);
+};
+
+struct boid_params {
+    int32_t group_size; // the number of boids to group with, or unlimited if not positive
+    int32_t boid_avoid; // the number of boids to avoid, or unlimited if not positive
+    float min_distance; // the distance under which boids avoid each other
+};
+
+/**
+ * The part of the flocking rules which depends on the other boids.
+ */
+struct boid_neighbourhood {
+    float centre[3]; // the sum of the positions of the boids grouped with
+    uint32_t grouped; // the number of boids grouped with
+    float separation[3]; // the direction away from the boids which are too close
+};
+
+/**
+ * A set of kernels compiled for a single instruction set.
+ */
+struct kernel_table {
+    const char *name;
+
+    /**
+     * Moves every position along its velocity, then applies quadratic drag.
+     */
+    void (*integrate)(const flock_arrays &flock, float step, float drag);
+
+    /**
+     * Works out the neighbourhood of a single boid from the
+     * positions and groups of all of them.
+     */
+    boid_neighbourhood (*neighbourhood)(const flock_arrays &flock, size_t self, const boid_params &params);
+
+    /**
+     * Interleaves the position and orientation of every fish into
+     * eight floats each: x, y, z, slot then the quaternion x, y, z, w.
+     */
+    void (*pack_instances)(const flock_arrays &flock, float *instances);
+
+    /**
+     * As pack_instances, but quantized to eight 16-bit values: the position
+     * as unorm within [-extent, extent], the slot as is, then the quaternion as snorm.
+     * Every slot must be below QUANTIZED_SLOTS, which is not checked here.
+     */
+    void (*pack_quantized_instances)(const flock_arrays &flock, float extent, uint16_t *instances);
+
+    /**
+     * Decodes fish stored in the compact format into the arrays.
+     *
+     * @param positions The packed_position records, each four 32-bit words:
+     *                  x | y << 16, z, then the low and high words of the
+     *                  smallest-three orientation.
+     * @param velocities The packed_velocity records, each two 32-bit words
+     *                   of half floats: x | y << 16, and z. May be null.
+     * @param extent The half-size of the cube the positions are fixed within.
+     */
+    void (*unpack)(const void *positions, const void *velocities, float extent, const flock_arrays &flock);
+
+    /**
+     * Finds the fish whose bounding spheres aren't wholly behind any of the planes.
+     *
+     * @param planes The normalized planes as nx, ny, nz, d, facing inwards.
+     * @param visible Receives the indices of the visible fish, in order.
+     * @returns The number of visible fish.
+     */
+    size_t (*cull)(const flock_arrays &flock, const float *planes, size_t planeCount, float radius, int32_t *visible);
+};
+
+/**
+ * Gets the best set of kernels supported by this cpu, selected on first use.
+ * Setting AQUARIUM_SIMD to scalar, sse42, avx2 or avx512 caps the selection.
+ */
+const kernel_table &kernels();
+
+// the kernels compiled for each instruction set, or null if they weren't
+namespace scalar { const kernel_table *table(); }
+namespace sse42 { const kernel_table *table(); }
+namespace avx2 { const kernel_table *table(); }
+namespace avx512 { const kernel_table *table(); }
+
+}
@@ -0,0 +1,318 @@
+/**
+ * The bodies of the simulation kernels, included once per instruction set
+ * by the kernels_*.cpp files which define SIMD_NAMESPACE beforehand.
+ */
+
+#include "simd.hpp"
+#include "kernels.hpp"
+
+#define SIMD_STRINGIFY(x) #x
+#define SIMD_NAME(x) SIMD_STRINGIFY(x)
+
+namespace simd {
+namespace SIMD_NAMESPACE {
+
+template<typename F>
+static void integrateLanes(const flock_arrays &flock, size_t i, float step, float drag) {
+    F vx = F::load(flock.vx + i);
+    F vy = F::load(flock.vy + i);
+    F vz = F::load(flock.vz + i);
+
+    F s = F::broadcast(step);
+    (F::load(flock.px + i) + vx * s).store(flock.px + i);
+    (F::load(flock.py + i) + vy * s).store(flock.py + i);
+    (F::load(flock.pz + i) + vz * s).store(flock.pz + i);
+
+    // drag of |v|^2 against the direction of travel, which is v * (1 - |v| * drag)
+    F keep = F::broadcast(1.0f) - sqrt(vx * vx + vy * vy + vz * vz) * F::broadcast(drag);
+    (vx * keep).store(flock.vx + i);
+    (vy * keep).store(flock.vy + i);
+    (vz * keep).store(flock.vz + i);
+}
+
+static void integrate(const flock_arrays &flock, float step, float drag) {
+    size_t i = 0;
+    for (; i + vfloat::lanes <= flock.count; i += vfloat::lanes) integrateLanes<vfloat>(flock, i, step, drag);
+    for (; i < flock.count; i++) integrateLanes<float1>(flock, i, step, drag);
+}
+
+/**
+ * Keeps only as many of the lowest set bits as fit under the limit,
+ * matching a scalar loop which stops after the first few matches.
+ */
+static uint32_t take(uint32_t bits, uint32_t &taken, int32_t limit) {
+    if (limit <= 0) {
+        for (uint32_t rest = bits; rest; rest &= rest - 1) taken++;
+        return bits;
+    }
+
+    uint32_t kept = 0;
+    for (; bits && taken < (uint32_t) limit; taken++) {
+        uint32_t lowest = bits & (~bits + 1);
+        kept |= lowest;
+        bits ^= lowest;
+    }
+    return kept;
+}
+
+template<typename F>
+struct neighbourhood_sums {
+    F centre[3];
+    F separation[3];
+};
+
+template<typename F>
+static void neighbourhoodLanes(const flock_arrays &flock, size_t i, size_t self, const boid_params &params,
+                               neighbourhood_sums<F> &sums, uint32_t &grouped, uint32_t &avoided) {
+    using I = typename F::integer;
+    using M = typename F::mask;
+
+    const F zero = F::broadcast(0.0f);
+    const F x = F::load(flock.px + i);
+    const F y = F::load(flock.py + i);
+    const F z = F::load(flock.pz + i);
+
+    // the boid should ignore itself
+    uint32_t others = (1u << F::lanes) - 1u;
+    if (self >= i && self < i + F::lanes) others &= ~(1u << (self - i));
+
+    // rule 1: group with boids from the same group
+    uint32_t sameGroup = (I::load(flock.group + i) == I::broadcast(flock.group[self])).bits() & others;
+    M grouping = M::from_bits(take(sameGroup, grouped, params.group_size));
+    sums.centre[0] = sums.centre[0] + select(grouping, x, zero);
+    sums.centre[1] = sums.centre[1] + select(grouping, y, zero);
+    sums.centre[2] = sums.centre[2] + select(grouping, z, zero);
+
+    // rule 2: keep away from boids which are too close
+    F gx = x - F::broadcast(flock.px[self]);
+    F gy = y - F::broadcast(flock.py[self]);
+    F gz = z - F::broadcast(flock.pz[self]);
+    F distance = sqrt(gx * gx + gy * gy + gz * gz);
+    F minDistance = F::broadcast(params.min_distance);
+    uint32_t tooClose = (distance <= minDistance).bits() & others;
+    M avoiding = M::from_bits(take(tooClose, avoided, params.boid_avoid));
+    F push = (minDistance - distance) / distance;
+    sums.separation[0] = sums.separation[0] - select(avoiding, gx * push, zero);
+    sums.separation[1] = sums.separation[1] - select(avoiding, gy * push, zero);
+    sums.separation[2] = sums.separation[2] - select(avoiding, gz * push, zero);
+}
+
+static bool full(uint32_t taken, int32_t limit) {
+    return limit > 0 && taken >= (uint32_t) limit;
+}
+
+static boid_neighbourhood neighbourhood(const flock_arrays &flock, size_t self, const boid_params &params) {
+    neighbourhood_sums<vfloat> wide = {};
+    neighbourhood_sums<float1> narrow = {};
+    for (int axis = 0; axis < 3; axis++) {
+        wide.centre[axis] = wide.separation[axis] = vfloat::broadcast(0.0f);
+        narrow.centre[axis] = narrow.separation[axis] = float1::broadcast(0.0f);
+    }
+
+    uint32_t grouped = 0;
+    uint32_t avoided = 0;
+    size_t i = 0;
+    for (; i + vfloat::lanes <= flock.count; i += vfloat::lanes) {
+        if (full(grouped, params.group_size) && full(avoided, params.boid_avoid)) break;
+        neighbourhoodLanes<vfloat>(flock, i, self, params, wide, grouped, avoided);
+    }
+    for (; i < flock.count; i++) {
+        if (full(grouped, params.group_size) && full(avoided, params.boid_avoid)) break;
+        neighbourhoodLanes<float1>(flock, i, self, params, narrow, grouped, avoided);
+    }
+
+    boid_neighbourhood result = {};
+    for (int axis = 0; axis < 3; axis++) {
+        result.centre[axis] = reduce_add(wide.centre[axis]) + reduce_add(narrow.centre[axis]);
+        result.separation[axis] = reduce_add(wide.separation[axis]) + reduce_add(narrow.separation[axis]);
+    }
+    result.grouped = grouped;
+    return result;
+}
+
+/**
+ * Gets the instance slot of each lane as a float, or zero if there are no slots.
+ */
+template<typename F>
+static F slotLanes(const flock_arrays &flock, size_t i) {
+    if (flock.slot == nullptr) return F::broadcast(0.0f);
+    return to_float(F::integer::load(flock.slot + i));
+}
+
+template<typename F>
+static void packLanes(const flock_arrays &flock, size_t i, float *instances) {
+    F values[8] = {
+            F::load(flock.px + i), F::load(flock.py + i), F::load(flock.pz + i), slotLanes<F>(flock, i),
+            F::load(flock.qx + i), F::load(flock.qy + i), F::load(flock.qz + i), F::load(flock.qw + i),
+    };
+
+    float lanes[F::lanes];
+    for (size_t component = 0; component < 8; component++) {
+        values[component].store(lanes);
+        for (size_t lane = 0; lane < F::lanes; lane++) instances[(i + lane) * 8 + component] = lanes[lane];
+    }
+}
+
+static void packInstances(const flock_arrays &flock, float *instances) {
+    size_t i = 0;
+    for (; i + vfloat::lanes <= flock.count; i += vfloat::lanes) packLanes<vfloat>(flock, i, instances);
+    for (; i < flock.count; i++) packLanes<float1>(flock, i, instances);
+}
+
+template<typename F>
+static void packQuantizedLanes(const flock_arrays &flock, size_t i, float extent, uint16_t *instances) {
+    const F scale = F::broadcast(65535.0f / (2.0f * extent));
+    const F offset = F::broadcast(extent);
+    const F one = F::broadcast(1.0f);
+    const F zero = F::broadcast(0.0f);
+
+    // unorm positions within the tank followed by snorm orientations
+    F values[8] = {
+            min(max((F::load(flock.px + i) + offset) * scale, zero), F::broadcast(65535.0f)),
+            min(max((F::load(flock.py + i) + offset) * scale, zero), F::broadcast(65535.0f)),
+            min(max((F::load(flock.pz + i) + offset) * scale, zero), F::broadcast(65535.0f)),
+            slotLanes<F>(flock, i),
+            min(max(F::load(flock.qx + i), zero - one), one) * F::broadcast(32767.0f),
+            min(max(F::load(flock.qy + i), zero - one), one) * F::broadcast(32767.0f),
+            min(max(F::load(flock.qz + i), zero - one), one) * F::broadcast(32767.0f),
+            min(max(F::load(flock.qw + i), zero - one), one) * F::broadcast(32767.0f),
+    };
+
+    int32_t lanes[F::lanes];
+    for (size_t component = 0; component < 8; component++) {
+        to_int(values[component]).store(lanes);
+        for (size_t lane = 0; lane < F::lanes; lane++) {
+            instances[(i + lane) * 8 + component] = (uint16_t) lanes[lane];
+        }
+    }
+}
+
+static void packQuantizedInstances(const flock_arrays &flock, float extent, uint16_t *instances) {
+    size_t i = 0;
+    for (; i + vfloat::lanes <= flock.count; i += vfloat::lanes) packQuantizedLanes<vfloat>(flock, i, extent, instances);
+    for (; i < flock.count; i++) packQuantizedLanes<float1>(flock, i, extent, instances);
+}
+
+template<typename F>
+static size_t cullLanes(const flock_arrays &flock, size_t i, const float *planes, size_t planeCount, float radius,
+                        int32_t *visible) {
+    const F x = F::load(flock.px + i);
+    const F y = F::load(flock.py + i);
+    const F z = F::load(flock.pz + i);
+    const F reach = F::broadcast(-radius);
+
+    uint32_t inside = ~0u >> (32 - F::lanes);
+    for (size_t plane = 0; plane < planeCount; plane++) {
+        const float *p = planes + plane * 4;
+        F distance = x * F::broadcast(p[0]) + y * F::broadcast(p[1]) + z * F::broadcast(p[2]) + F::broadcast(p[3]);
+        inside &= (reach <= distance).bits();
+    }
+
+    size_t found = 0;
+    for (size_t lane = 0; lane < F::lanes; lane++) {
+        if ((inside >> lane) & 1u) visible[found++] = (int32_t) (i + lane);
+    }
+    return found;
+}
+
+static size_t cull(const flock_arrays &flock, const float *planes, size_t planeCount, float radius, int32_t *visible) {
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + vfloat::lanes <= flock.count; i += vfloat::lanes) {
+        found += cullLanes<vfloat>(flock, i, planes, planeCount, radius, visible + found);
+    }
+    for (; i < flock.count; i++) found += cullLanes<float1>(flock, i, planes, planeCount, radius, visible + found);
+    return found;
+}
+
+/**
+ * Converts the low 16 bits of each lane from half to single precision.
+ * Infinities and nans aren't handled, as velocities never hold them.
+ */
+template<typename I>
+static auto halfToFloat(I half) {
+    using F = decltype(as_float(half));
+    I sign = (half & I::broadcast(0x8000)) << 16;
+    F magnitude = as_float((half & I::broadcast(0x7fff)) << 13) * F::broadcast(5.192296858534828e+33f); // 2^112
+    return as_float(as_int(magnitude) | sign);
+}
+
+template<typename F>
+static void unpackLanes(const int32_t *positions, const int32_t *velocities, size_t i, float extent,
+                        const flock_arrays &flock) {
+    using I = typename F::integer;
+
+    int32_t indices[F::lanes];
+    for (size_t lane = 0; lane < F::lanes; lane++) indices[lane] = (int32_t) ((i + lane) * 4);
+
+    // fixed point positions within [-extent, extent]
+    I xy = I::gather(positions, indices);
+    for (auto &index : indices) index++;
+    I z = I::gather(positions, indices);
+    for (auto &index : indices) index++;
+    I orientationLow = I::gather(positions, indices);
+    for (auto &index : indices) index++;
+    I orientationHigh = I::gather(positions, indices);
+
+    const I low = I::broadcast(0xffff);
+    const F scale = F::broadcast(2.0f * extent / 65535.0f);
+    const F offset = F::broadcast(-extent);
+    (to_float(xy & low) * scale + offset).store(flock.px + i);
+    (to_float(xy >> 16) * scale + offset).store(flock.py + i);
+    (to_float(z & low) * scale + offset).store(flock.pz + i);
+
+    // smallest three in 20 bits each, the middle one straddling the two words,
+    // with the index of the dropped component above them
+    const I twentyBits = I::broadcast(0xfffff);
+    const F unit = F::broadcast(2.0f / 1048575.0f / 1.41421356f);
+    const F bias = F::broadcast(-1.0f / 1.41421356f);
+    F a = to_float((orientationHigh >> 8) & twentyBits) * unit + bias;
+    F b = to_float((orientationLow >> 20) | ((orientationHigh & I::broadcast(0xff)) << 12)) * unit + bias;
+    F c = to_float(orientationLow & twentyBits) * unit + bias;
+    F largest = sqrt(max(F::broadcast(1.0f) - a * a - b * b - c * c, F::broadcast(0.0f)));
+
+    I dropped = orientationHigh >> 28;
+    auto isX = dropped == I::broadcast(0);
+    auto isY = dropped == I::broadcast(1);
+    auto isZ = dropped == I::broadcast(2);
+    auto isW = dropped == I::broadcast(3);
+    select(isX, largest, a).store(flock.qx + i);
+    select(isX, a, select(isY, largest, b)).store(flock.qy + i);
+    select(isZ, largest, select(isW, c, b)).store(flock.qz + i);
+    select(isW, largest, c).store(flock.qw + i);
+
+    if (velocities == nullptr) return;
+
+    // half precision velocities
+    for (size_t lane = 0; lane < F::lanes; lane++) indices[lane] = (int32_t) ((i + lane) * 2);
+    I vxy = I::gather(velocities, indices);
+    for (auto &index : indices) index++;
+    I vz = I::gather(velocities, indices);
+    halfToFloat(vxy & low).store(flock.vx + i);
+    halfToFloat(vxy >> 16).store(flock.vy + i);
+    halfToFloat(vz & low).store(flock.vz + i);
+}
+
+static void unpack(const void *positions, const void *velocities, float extent, const flock_arrays &flock) {
+    auto *p = (const int32_t *) positions;
+    auto *v = (const int32_t *) velocities;
+    size_t i = 0;
+    for (; i + vfloat::lanes <= flock.count; i += vfloat::lanes) unpackLanes<vfloat>(p, v, i, extent, flock);
+    for (; i < flock.count; i++) unpackLanes<float1>(p, v, i, extent, flock);
+}
+
+const kernel_table *table() {
+    static const kernel_table kernels = {
+            SIMD_NAME(SIMD_NAMESPACE),
+            integrate,
+            neighbourhood,
+            packInstances,
+            packQuantizedInstances,
+            unpack,
+            cull,
+    };
+    return &kernels;
+}
+
+}
+}
@@ -0,0 +1,14 @@
+#if defined(__AVX2__)
+
+#define SIMD_AVX2
+#define SIMD_NAMESPACE avx2
+
+#include "kernels.inl"
+
+#else
+
+#include "kernels.hpp"
+
+const simd::kernel_table *simd::avx2::table() { return nullptr; }
+
+#endif
@@ -0,0 +1,25 @@
+#if defined(__AVX512F__)
+
+#define SIMD_AVX512
+#define SIMD_NAMESPACE avx512
+
+// gcc 12 warns that the _mm512_undefined_* values inside its own intrinsics are
+// uninitialized (https://gcc.gnu.org/bugzilla/show_bug.cgi?id=105593), so they
+// are included first with the warning off, the include in simd.hpp then does nothing
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
+
+#include "kernels.inl"
+
+#else
+
+#include "kernels.hpp"
+
+const simd::kernel_table *simd::avx512::table() { return nullptr; }
+
+#endif
@@ -0,0 +1,3 @@
+#define SIMD_NAMESPACE scalar
+
+#include "kernels.inl"
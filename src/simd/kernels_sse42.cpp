@@ -0,0 +1,14 @@
+#if defined(__SSE4_2__) || defined(_M_X64) || defined(_M_AMD64)
+
+#define SIMD_SSE42
+#define SIMD_NAMESPACE sse42
+
+#include "kernels.inl"
+
+#else
+
+#include "kernels.hpp"
+
+const simd::kernel_table *simd::sse42::table() { return nullptr; }
+
+#endif
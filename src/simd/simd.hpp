@@ -0,0 +1,335 @@
+#pragma once
+
+/**
+ * A thin wrapper over the SIMD instruction sets, so that kernels
+ * can be written once against it and compiled for each of them.
+ *
+ * Each translation unit which includes this must first define
+ * SIMD_NAMESPACE, and one of SIMD_AVX512, SIMD_AVX2 or SIMD_SSE42
+ * (or none, for the scalar fallback). Everything is declared inside
+ * that namespace so that the copies compiled with different flags
+ * never get merged by the linker.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(SIMD_AVX512) || defined(SIMD_AVX2) || defined(SIMD_SSE42)
+
+#include <immintrin.h>
+
+#endif
+
+#ifndef SIMD_NAMESPACE
+#error "SIMD_NAMESPACE must be defined before including simd.hpp"
+#endif
+
+namespace simd {
+namespace SIMD_NAMESPACE {
+
+struct mask1 {
+    bool m;
+
+    static mask1 from_bits(uint32_t bits) { return {(bits & 1u) != 0}; }
+
+    uint32_t bits() const { return m ? 1u : 0u; }
+};
+
+struct int1 {
+    int32_t v;
+    using mask = mask1;
+
+    static int1 load(const int32_t *p) { return {*p}; }
+
+    static int1 broadcast(int32_t i) { return {i}; }
+
+    static int1 gather(const int32_t *base, const int32_t *indices) { return {base[indices[0]]}; }
+
+    void store(int32_t *p) const { *p = v; }
+};
+
+/**
+ * A single float, used for the remainder which doesn't fill a whole vector.
+ */
+struct float1 {
+    float v;
+    static constexpr size_t lanes = 1;
+    using mask = mask1;
+    using integer = int1;
+
+    static float1 load(const float *p) { return {*p}; }
+
+    static float1 broadcast(float f) { return {f}; }
+
+    static float1 gather(const float *base, const int32_t *indices) { return {base[indices[0]]}; }
+
+    void store(float *p) const { *p = v; }
+};
+
+inline mask1 operator&(mask1 a, mask1 b) { return {a.m && b.m}; }
+inline mask1 operator|(mask1 a, mask1 b) { return {a.m || b.m}; }
+inline mask1 operator~(mask1 a) { return {!a.m}; }
+inline mask1 operator==(int1 a, int1 b) { return {a.v == b.v}; }
+inline int1 operator&(int1 a, int1 b) { return {a.v & b.v}; }
+inline int1 operator|(int1 a, int1 b) { return {a.v | b.v}; }
+inline int1 operator<<(int1 a, int count) { return {(int32_t) ((uint32_t) a.v << count)}; }
+inline int1 operator>>(int1 a, int count) { return {(int32_t) ((uint32_t) a.v >> count)}; }
+inline float1 to_float(int1 a) { return {(float) a.v}; }
+inline int1 to_int(float1 a) { return {(int32_t) lrintf(a.v)}; }
+
+inline float1 as_float(int1 a) {
+    float1 f;
+    memcpy(&f.v, &a.v, sizeof(float));
+    return f;
+}
+
+inline int1 as_int(float1 a) {
+    int1 i;
+    memcpy(&i.v, &a.v, sizeof(float));
+    return i;
+}
+
+inline float1 operator+(float1 a, float1 b) { return {a.v + b.v}; }
+inline float1 operator-(float1 a, float1 b) { return {a.v - b.v}; }
+inline float1 operator*(float1 a, float1 b) { return {a.v * b.v}; }
+inline float1 operator/(float1 a, float1 b) { return {a.v / b.v}; }
+inline mask1 operator<(float1 a, float1 b) { return {a.v < b.v}; }
+inline mask1 operator<=(float1 a, float1 b) { return {a.v <= b.v}; }
+inline float1 min(float1 a, float1 b) { return {a.v < b.v ? a.v : b.v}; }
+inline float1 max(float1 a, float1 b) { return {a.v > b.v ? a.v : b.v}; }
+inline float1 sqrt(float1 a) { return {::sqrtf(a.v)}; }
+inline float1 select(mask1 m, float1 a, float1 b) { return m.m ? a : b; }
+inline float reduce_add(float1 a) { return a.v; }
+
+#if defined(SIMD_AVX512)
+
+struct vmask {
+    __mmask16 m;
+
+    static vmask from_bits(uint32_t bits) { return {(__mmask16) bits}; }
+
+    uint32_t bits() const { return m; }
+};
+
+struct vint {
+    __m512i v;
+    using mask = vmask;
+
+    static vint load(const int32_t *p) { return {_mm512_loadu_si512(p)}; }
+
+    static vint broadcast(int32_t i) { return {_mm512_set1_epi32(i)}; }
+
+    static vint gather(const int32_t *base, const int32_t *indices) {
+        return {_mm512_i32gather_epi32(_mm512_loadu_si512(indices), base, 4)};
+    }
+
+    void store(int32_t *p) const { _mm512_storeu_si512(p, v); }
+};
+
+struct vfloat {
+    __m512 v;
+    static constexpr size_t lanes = 16;
+    using mask = vmask;
+    using integer = vint;
+
+    static vfloat load(const float *p) { return {_mm512_loadu_ps(p)}; }
+
+    static vfloat broadcast(float f) { return {_mm512_set1_ps(f)}; }
+
+    static vfloat gather(const float *base, const int32_t *indices) {
+        return {_mm512_i32gather_ps(_mm512_loadu_si512(indices), base, 4)};
+    }
+
+    void store(float *p) const { _mm512_storeu_ps(p, v); }
+};
+
+inline vmask operator&(vmask a, vmask b) { return {(__mmask16) (a.m & b.m)}; }
+inline vmask operator|(vmask a, vmask b) { return {(__mmask16) (a.m | b.m)}; }
+inline vmask operator~(vmask a) { return {(__mmask16) ~a.m}; }
+inline vmask operator==(vint a, vint b) { return {_mm512_cmpeq_epi32_mask(a.v, b.v)}; }
+inline vint operator&(vint a, vint b) { return {_mm512_and_si512(a.v, b.v)}; }
+inline vint operator|(vint a, vint b) { return {_mm512_or_si512(a.v, b.v)}; }
+inline vint operator<<(vint a, int count) { return {_mm512_sll_epi32(a.v, _mm_cvtsi32_si128(count))}; }
+inline vint operator>>(vint a, int count) { return {_mm512_srl_epi32(a.v, _mm_cvtsi32_si128(count))}; }
+
+inline vfloat operator+(vfloat a, vfloat b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline vfloat operator-(vfloat a, vfloat b) { return {_mm512_sub_ps(a.v, b.v)}; }
+inline vfloat operator*(vfloat a, vfloat b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline vfloat operator/(vfloat a, vfloat b) { return {_mm512_div_ps(a.v, b.v)}; }
+inline vmask operator<(vfloat a, vfloat b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)}; }
+inline vfloat min(vfloat a, vfloat b) { return {_mm512_min_ps(a.v, b.v)}; }
+inline vfloat max(vfloat a, vfloat b) { return {_mm512_max_ps(a.v, b.v)}; }
+inline vfloat sqrt(vfloat a) { return {_mm512_sqrt_ps(a.v)}; }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return {_mm512_mask_blend_ps(m.m, b.v, a.v)}; }
+inline float reduce_add(vfloat a) { return _mm512_reduce_add_ps(a.v); }
+inline vfloat to_float(vint a) { return {_mm512_cvtepi32_ps(a.v)}; }
+inline vint to_int(vfloat a) { return {_mm512_cvtps_epi32(a.v)}; }
+inline vfloat as_float(vint a) { return {_mm512_castsi512_ps(a.v)}; }
+inline vint as_int(vfloat a) { return {_mm512_castps_si512(a.v)}; }
+
+#elif defined(SIMD_AVX2)
+
+struct vmask {
+    __m256 m;
+
+    static vmask from_bits(uint32_t bits) {
+        const __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i set = _mm256_and_si256(_mm256_set1_epi32((int) bits), lane);
+        return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(set, lane))};
+    }
+
+    uint32_t bits() const { return (uint32_t) _mm256_movemask_ps(m); }
+};
+
+struct vint {
+    __m256i v;
+    using mask = vmask;
+
+    static vint load(const int32_t *p) { return {_mm256_loadu_si256((const __m256i *) p)}; }
+
+    static vint broadcast(int32_t i) { return {_mm256_set1_epi32(i)}; }
+
+    static vint gather(const int32_t *base, const int32_t *indices) {
+        return {_mm256_i32gather_epi32(base, _mm256_loadu_si256((const __m256i *) indices), 4)};
+    }
+
+    void store(int32_t *p) const { _mm256_storeu_si256((__m256i *) p, v); }
+};
+
+struct vfloat {
+    __m256 v;
+    static constexpr size_t lanes = 8;
+    using mask = vmask;
+    using integer = vint;
+
+    static vfloat load(const float *p) { return {_mm256_loadu_ps(p)}; }
+
+    static vfloat broadcast(float f) { return {_mm256_set1_ps(f)}; }
+
+    static vfloat gather(const float *base, const int32_t *indices) {
+        return {_mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i *) indices), 4)};
+    }
+
+    void store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline vmask operator&(vmask a, vmask b) { return {_mm256_and_ps(a.m, b.m)}; }
+inline vmask operator|(vmask a, vmask b) { return {_mm256_or_ps(a.m, b.m)}; }
+inline vmask operator~(vmask a) { return {_mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))}; }
+inline vmask operator==(vint a, vint b) { return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(a.v, b.v))}; }
+inline vint operator&(vint a, vint b) { return {_mm256_and_si256(a.v, b.v)}; }
+inline vint operator|(vint a, vint b) { return {_mm256_or_si256(a.v, b.v)}; }
+inline vint operator<<(vint a, int count) { return {_mm256_sll_epi32(a.v, _mm_cvtsi32_si128(count))}; }
+inline vint operator>>(vint a, int count) { return {_mm256_srl_epi32(a.v, _mm_cvtsi32_si128(count))}; }
+inline vfloat to_float(vint a) { return {_mm256_cvtepi32_ps(a.v)}; }
+inline vint to_int(vfloat a) { return {_mm256_cvtps_epi32(a.v)}; }
+inline vfloat as_float(vint a) { return {_mm256_castsi256_ps(a.v)}; }
+inline vint as_int(vfloat a) { return {_mm256_castps_si256(a.v)}; }
+
+inline vfloat operator+(vfloat a, vfloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline vfloat operator-(vfloat a, vfloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline vfloat operator*(vfloat a, vfloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline vfloat operator/(vfloat a, vfloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline vmask operator<(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline vfloat min(vfloat a, vfloat b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline vfloat max(vfloat a, vfloat b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline vfloat sqrt(vfloat a) { return {_mm256_sqrt_ps(a.v)}; }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return {_mm256_blendv_ps(b.v, a.v, m.m)}; }
+
+inline float reduce_add(vfloat a) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#elif defined(SIMD_SSE42)
+
+struct vmask {
+    __m128 m;
+
+    static vmask from_bits(uint32_t bits) {
+        const __m128i lane = _mm_setr_epi32(1, 2, 4, 8);
+        __m128i set = _mm_and_si128(_mm_set1_epi32((int) bits), lane);
+        return {_mm_castsi128_ps(_mm_cmpeq_epi32(set, lane))};
+    }
+
+    uint32_t bits() const { return (uint32_t) _mm_movemask_ps(m); }
+};
+
+struct vint {
+    __m128i v;
+    using mask = vmask;
+
+    static vint load(const int32_t *p) { return {_mm_loadu_si128((const __m128i *) p)}; }
+
+    static vint broadcast(int32_t i) { return {_mm_set1_epi32(i)}; }
+
+    static vint gather(const int32_t *base, const int32_t *indices) {
+        return {_mm_setr_epi32(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]])};
+    }
+
+    void store(int32_t *p) const { _mm_storeu_si128((__m128i *) p, v); }
+};
+
+struct vfloat {
+    __m128 v;
+    static constexpr size_t lanes = 4;
+    using mask = vmask;
+    using integer = vint;
+
+    static vfloat load(const float *p) { return {_mm_loadu_ps(p)}; }
+
+    static vfloat broadcast(float f) { return {_mm_set1_ps(f)}; }
+
+    static vfloat gather(const float *base, const int32_t *indices) {
+        return {_mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]])};
+    }
+
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+};
+
+inline vmask operator&(vmask a, vmask b) { return {_mm_and_ps(a.m, b.m)}; }
+inline vmask operator|(vmask a, vmask b) { return {_mm_or_ps(a.m, b.m)}; }
+inline vmask operator~(vmask a) { return {_mm_xor_ps(a.m, _mm_castsi128_ps(_mm_set1_epi32(-1)))}; }
+inline vmask operator==(vint a, vint b) { return {_mm_castsi128_ps(_mm_cmpeq_epi32(a.v, b.v))}; }
+inline vint operator&(vint a, vint b) { return {_mm_and_si128(a.v, b.v)}; }
+inline vint operator|(vint a, vint b) { return {_mm_or_si128(a.v, b.v)}; }
+inline vint operator<<(vint a, int count) { return {_mm_sll_epi32(a.v, _mm_cvtsi32_si128(count))}; }
+inline vint operator>>(vint a, int count) { return {_mm_srl_epi32(a.v, _mm_cvtsi32_si128(count))}; }
+inline vfloat to_float(vint a) { return {_mm_cvtepi32_ps(a.v)}; }
+inline vint to_int(vfloat a) { return {_mm_cvtps_epi32(a.v)}; }
+inline vfloat as_float(vint a) { return {_mm_castsi128_ps(a.v)}; }
+inline vint as_int(vfloat a) { return {_mm_castps_si128(a.v)}; }
+
+inline vfloat operator+(vfloat a, vfloat b) { return {_mm_add_ps(a.v, b.v)}; }
+inline vfloat operator-(vfloat a, vfloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline vfloat operator*(vfloat a, vfloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline vfloat operator/(vfloat a, vfloat b) { return {_mm_div_ps(a.v, b.v)}; }
+inline vmask operator<(vfloat a, vfloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline vmask operator<=(vfloat a, vfloat b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline vfloat min(vfloat a, vfloat b) { return {_mm_min_ps(a.v, b.v)}; }
+inline vfloat max(vfloat a, vfloat b) { return {_mm_max_ps(a.v, b.v)}; }
+inline vfloat sqrt(vfloat a) { return {_mm_sqrt_ps(a.v)}; }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return {_mm_blendv_ps(b.v, a.v, m.m)}; }
+
+inline float reduce_add(vfloat a) {
+    __m128 sum = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#else
+
+using vmask = mask1;
+using vint = int1;
+using vfloat = float1;
+
+#endif
+
+}
+}
@@ -0,0 +1,84 @@
+#include "stream_buffer.hpp"
+#include "gl_state.hpp"
+
+static const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+stream_buffer::stream_buffer() : persistent(GLAD_GL_ARB_buffer_storage != 0) {
+    glGenBuffers(1, &this->bufferID);
+}
+
+void *stream_buffer::map(size_t bytes) {
+    this->region = (this->region + 1) % REGIONS;
+
+    if (bytes > this->regionSize) {
+        // wait for every region before replacing the storage under them
+        for (size_t i = 0; i < REGIONS; i++) this->wait(i);
+        size_t size = this->regionSize ? this->regionSize : 4096;
+        while (size < bytes) size *= 2;
+        this->allocate(size);
+    } else {
+        this->wait(this->region);
+    }
+
+    const size_t offset = this->region * this->regionSize;
+    if (this->persistent) return this->mapped + offset;
+
+    gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, this->bufferID);
+    void *pointer = glMapBufferRange(GL_ARRAY_BUFFER, offset, this->regionSize,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    return pointer;
+}
+
+size_t stream_buffer::unmap() {
+    if (!this->persistent) {
+        gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, this->bufferID);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    return this->region * this->regionSize;
+}
+
+void stream_buffer::fence() {
+    this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint stream_buffer::id() const {
+    return this->bufferID;
+}
+
+void stream_buffer::close() {
+    for (size_t i = 0; i < REGIONS; i++) this->wait(i);
+    gl_state::getInstance().deleteBuffer(this->bufferID);
+    this->mapped = nullptr;
+}
+
+/**
+ * Replaces the buffer storage with regions of the given size. Immutable
+ * storage can not be resized, so the persistent buffer is recreated.
+ */
+void stream_buffer::allocate(size_t size) {
+    this->regionSize = size;
+
+    if (this->persistent) {
+        gl_state::getInstance().deleteBuffer(this->bufferID);
+        glGenBuffers(1, &this->bufferID);
+        gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, this->bufferID);
+        glBufferStorage(GL_ARRAY_BUFFER, size * REGIONS, nullptr, persistentFlags);
+        this->mapped = (char *) glMapBufferRange(GL_ARRAY_BUFFER, 0, size * REGIONS, persistentFlags);
+    } else {
+        gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, this->bufferID);
+        glBufferData(GL_ARRAY_BUFFER, size * REGIONS, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+/**
+ * Blocks until the gpu has finished with a region.
+ */
+void stream_buffer::wait(size_t index) {
+    GLsync sync = this->fences[index];
+    if (!sync) return;
+
+    while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(sync);
+    this->fences[index] = nullptr;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+/**
+ * A buffer for per-frame data which is written by the cpu and read once
+ * by the gpu. The buffer is split into three regions which are used in
+ * turn, each guarded by a fence, so writing one frame never waits on the
+ * gpu still drawing the last.
+ *
+ * Where ARB_buffer_storage is available the buffer is mapped once,
+ * persistently and coherently, so data is written straight into gpu
+ * visible memory. Otherwise each region is mapped and unmapped per frame.
+ */
+class stream_buffer {
+public:
+    static constexpr size_t REGIONS = 3;
+
+    stream_buffer();
+
+    /**
+     * Waits for the next region to be free and returns it for writing.
+     * @param bytes The number of bytes that will be written, growing the buffer if needed.
+     */
+    void *map(size_t bytes);
+
+    /**
+     * Finishes writing the current region.
+     * @returns The byte offset of the region in the buffer, to point attributes at.
+     */
+    size_t unmap();
+
+    /**
+     * Marks the current region as in use by the commands issued so far.
+     * Call this after the draws which read the region.
+     */
+    void fence();
+
+    GLuint id() const;
+
+    void close();
+
+private:
+    GLuint bufferID = 0;
+    size_t regionSize = 0;
+    size_t region = 0; // the region currently being written
+    bool persistent;
+    char *mapped = nullptr; // the start of the persistent mapping
+    std::array<GLsync, REGIONS> fences{};
+
+    void allocate(size_t size);
+
+    void wait(size_t index);
+};
@@ -2,69 +2,43 @@
 // Created by Alexander Lyon on 2019-10-23.
 //
 
-#include <glm/gtx/fast_square_root.hpp>
-
 #include "boids.hpp"
 #include "../components/components.hpp"
 #include "../settings.hpp"
+#include "../simd/kernels.hpp"
+#include "flock.hpp"
 
-const Settings &s = Settings::getInstance();
+static flock staged;
 
 /**
  * Rule 1: Boids want to move towards the centre of mass of neighbouring boids.
  */
-glm::vec3 rule1(entt::view<entt::exclude_t<>, position, fish> &sortedFish, entt::entity &ourEntity) {
-    auto ourPosition = sortedFish.get<position>(ourEntity);
-
-    uint8_t grouped_with = 0;
-    glm::vec3 direction = {};
-    for (auto &entity : sortedFish) {
-        if (entity == ourEntity) { continue;} // the fish should ignore itself
-        if (sortedFish.get<fish>(entity).getGroup() != sortedFish.get<fish>(ourEntity).getGroup()) continue; // the fish should only group with its own group
-        direction += sortedFish.get<position>(entity).position;
-        if (++grouped_with == s.group_size) break;
-    }
-
-    return direction / (float) grouped_with - ourPosition.position;
+glm::vec3 rule1(const simd::boid_neighbourhood &neighbourhood, const glm::vec3 &ourPosition) {
+    glm::vec3 direction = {neighbourhood.centre[0], neighbourhood.centre[1], neighbourhood.centre[2]};
+    return direction / (float) neighbourhood.grouped - ourPosition;
 }
 
 /**
  * Rule 2: Boids try to keep a small distance away from other objects (including other boids).
  */
-glm::vec3 rule2(entt::view<entt::exclude_t<>, position, fish> &sortedFish, entt::entity &ourEntity) {
-    auto ourPosition = sortedFish.get<position>(ourEntity);
-
-    uint8_t avoided = 0;
-    glm::vec3 direction = {};
-    for (auto &entity : sortedFish) {
-        if (entity == ourEntity) { continue; } // the fish should ignore itself
-        auto entPos = sortedFish.get<position>(entity);
-        auto gap = entPos.position - ourPosition.position;
-        auto distance = glm::fastLength(gap);
-        if (distance > s.min_boid_distance) continue;
-        direction -= (gap / distance) * (s.min_boid_distance - distance);
-        if (++avoided == s.boid_avoid) break;
-    }
-
-    return direction;
+glm::vec3 rule2(const simd::boid_neighbourhood &neighbourhood) {
+    return {neighbourhood.separation[0], neighbourhood.separation[1], neighbourhood.separation[2]};
 }
 
 /**
  * Additional Rule 4: Boids try to move toward the origin.
  */
-glm::vec3 rule4(entt::view<entt::exclude_t<>, position, fish> &sortedFish, entt::entity &ourEntity) {
-    return -sortedFish.get<position>(ourEntity).position;
+glm::vec3 rule4(const glm::vec3 &ourPosition) {
+    return -ourPosition;
 }
 
 /**
  * Additional Rule 5: Boids try to avoid the camera.
  */
-glm::vec3 rule5(entt::view<entt::exclude_t<>, position, fish> &sortedFish, entt::entity &ourEntity,
-                entt::registry &registry, entt::entity *avoid) {
-    auto ourPosition = sortedFish.get<position>(ourEntity);
+glm::vec3 rule5(const glm::vec3 &ourPosition, entt::registry &registry, entt::entity *avoid, const settings_snapshot &s) {
     auto avoidPos = registry.get<position>(*avoid);
 
-    auto gap = ourPosition.position - avoidPos.position;
+    auto gap = ourPosition - avoidPos.position;
     auto distance = glm::length(gap);
     if (distance > s.min_camera_distance) return glm::vec3{};
     else return gap * (s.min_camera_distance - distance);
@@ -73,30 +47,41 @@ glm::vec3 rule5(entt::view<entt::exclude_t<>, position, fish> &sortedFish, entt:
 /**
  * Makes the fish obey the flocking rules of Boids
  *
+ * The neighbourhood of each fish (rules 1 and 2) is found by the simd
+ * kernels, which scan the positions of the whole flock in storage order.
+ *
  * http://www.kfish.org/boids/pseudocode.html
  */
 void boids(entt::registry &registry, entt::entity *avoid, double deltaTime) {
-    auto allEntities = registry.view<fish, position>();
-    for (auto ourEntity : allEntities) {
-        auto &ourPosition = allEntities.get<position>(ourEntity);
+    const auto snapshot = Settings::getInstance().snapshot();
+    const settings_snapshot &s = *snapshot;
+
+    gatherFlock(registry, staged);
+    auto &buffer = staged.buffer;
 
-		// todo(arlyon) optimize: 80% of cpu time is spent sorting
-        registry.sort<position>([ourPosition](auto &lhs, auto &rhs) {
-            return (ourPosition.position - lhs.position).length() < (ourPosition.position - rhs.position).length();
-        }, entt::insertion_sort());
-        registry.sort<fish, position>();
-        auto sortedFish = registry.view<position, fish>();
+    const auto &kernels = simd::kernels();
+    const auto arrays = buffer.arrays();
+    const simd::boid_params params = {s.group_size, s.boid_avoid, s.min_boid_distance};
+    for (size_t i = 0; i < staged.entities.size(); i++) {
+        glm::vec3 ourPosition = {buffer.px[i], buffer.py[i], buffer.pz[i]};
+        auto neighbourhood = kernels.neighbourhood(arrays, i, params);
 
         glm::vec3 direction = {};
-        direction += rule1(sortedFish, ourEntity);
-        direction += rule2(sortedFish, ourEntity);
-        direction += rule4(sortedFish, ourEntity);
-        if (avoid != nullptr) direction += rule5(sortedFish, ourEntity, registry, avoid);
+        direction += rule1(neighbourhood, ourPosition);
+        direction += rule2(neighbourhood);
+        direction += rule4(ourPosition);
+        if (avoid != nullptr) direction += rule5(ourPosition, registry, avoid, s);
 
         if (glm::length(direction) > 0.01f) {
+            auto ourOrientation = glm::quat(buffer.qw[i], buffer.qx[i], buffer.qy[i], buffer.qz[i]);
             auto targetOrientation = glm::quatLookAt(glm::normalize(direction), glm::vec3(0, 1, 0));
-            auto newOrientation = glm::slerp(ourPosition.orientation, targetOrientation, 0.4f * (float)deltaTime * s.time_scale);
-            ourPosition.orientation = newOrientation;
+            auto newOrientation = glm::slerp(ourOrientation, targetOrientation, 0.4f * (float)deltaTime * s.time_scale);
+            buffer.qx[i] = newOrientation.x;
+            buffer.qy[i] = newOrientation.y;
+            buffer.qz[i] = newOrientation.z;
+            buffer.qw[i] = newOrientation.w;
         }
     }
-}
\ No newline at end of file
+
+    scatterFlock(registry, staged, FLOCK_ORIENTATION);
+}
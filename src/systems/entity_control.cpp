@@ -3,27 +3,28 @@
 //
 
 #include <iostream>
-#include <queue>
 
 #include <glad/glad.h>
 
 #include "entity_control.hpp"
 #include "../components/components.hpp"
 #include "../settings.hpp"
+#include "../ring_buffer.hpp"
 
-struct move_event {
-    double x;
-    double y;
-};
-
-struct scroll_event {
+/**
+ * A mouse event, recorded by the glfw callbacks.
+ */
+struct input_event {
+    enum {
+        MOVE,
+        SCROLL,
+    } type;
     double x;
     double y;
 };
 
 struct mouse_state {
-    std::queue<move_event> move;
-    std::queue<scroll_event> scroll;
+    ring_buffer<input_event, 256> events;
     double mouse_x;
     double mouse_y;
     bool first_mouse = true;
@@ -32,11 +33,11 @@ struct mouse_state {
 mouse_state state;
 
 void mouse_callback(GLFWwindow *, double xpos, double ypos) {
-    state.move.push({xpos, ypos});
+    state.events.push({input_event::MOVE, xpos, ypos});
 }
 
 void scroll_callback(GLFWwindow *, double xoffset, double yoffset) {
-    state.scroll.push({xoffset, yoffset});
+    state.events.push({input_event::SCROLL, xoffset, yoffset});
 }
 
 void key_callback(GLFWwindow *, int key, int, int action, int) {
@@ -56,30 +57,51 @@ void key_callback(GLFWwindow *, int key, int, int action, int) {
 }
 
 /**
- * Controls the given entity.
+ * Applies the mouse events received so far to the given entity.
+ *
+ * This should be called as late as possible in the frame, just before
+ * the view matrix is built, so that the camera reflects the latest input.
+ * While the menu is open the events are discarded.
  */
-void entity_control(entt::registry &registry, entt::entity *cam, GLFWwindow *window, double deltaTime) {
+void sample_input(entt::registry &registry, entt::entity *cam, double deltaTime) {
     Settings &s = Settings::getInstance();
-    auto &vel = registry.get<velocity>(*cam);
     auto &pos = registry.get<position>(*cam);
 
-    // pitch/yaw
-    while (!state.move.empty())
-    {
-        auto event = state.move.front();
+    // the callbacks run on this thread while events are polled, so everything queued came before this
+    input_event event;
+    while (state.events.pop(event)) {
+        if (s.enable_menu) {
+            state.first_mouse = true;
+            continue;
+        }
 
-        if (!state.first_mouse) {
-            double x_offset = (event.x - state.mouse_x) * s.mouse_sensitivity;
-            double y_offset = (state.mouse_y - event.y) * s.mouse_sensitivity;
-            pos.orientation *= glm::quat(glm::vec3(-y_offset, x_offset, 0) * pos.orientation);
+        if (event.type == input_event::MOVE) {
+            // pitch/yaw
+            if (!state.first_mouse) {
+                double x_offset = (event.x - state.mouse_x) * s.mouse_sensitivity;
+                double y_offset = (state.mouse_y - event.y) * s.mouse_sensitivity;
+                pos.orientation *= glm::quat(glm::vec3(-y_offset, x_offset, 0) * pos.orientation);
+            } else {
+                state.first_mouse = false;
+            }
+
+            state.mouse_x = event.x;
+            state.mouse_y = event.y;
         } else {
-            state.first_mouse = false;
+            // fov
+            s.fov += (float)event.y * (float)deltaTime * 2.0f;
+            if (s.fov < 1.0f) s.fov = 1.0f;
+            if (s.fov > 120.0f) s.fov = 120.0f;
         }
-
-        state.mouse_x = event.x;
-        state.mouse_y = event.y;
-        state.move.pop();
     }
+}
+
+/**
+ * Controls the given entity.
+ */
+void entity_control(entt::registry &registry, entt::entity *cam, GLFWwindow *window, double deltaTime) {
+    auto &vel = registry.get<velocity>(*cam);
+    auto &pos = registry.get<position>(*cam);
 
     // roll
     float roll = 0;
@@ -96,14 +118,4 @@ void entity_control(entt::registry &registry, entt::entity *cam, GLFWwindow *win
     if (glfwGetKey(window, GLFW_KEY_SPACE)) strafe += glm::vec3(0, 1, 0);
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT)) strafe += glm::vec3(0, -1, 0);
     vel.velocity += strafe * pos.orientation * (float)deltaTime * 5.0f; // move in the facing direction
-
-    // fov
-    while (!state.scroll.empty())
-    {
-        auto event = state.scroll.front();
-        s.fov += (float)event.y * (float)deltaTime * 2.0f;
-        if (s.fov < 1.0f) s.fov = 1.0f;
-        if (s.fov > 120.0f) s.fov = 120.0f;
-        state.scroll.pop();
-    }
-}
\ No newline at end of file
+}
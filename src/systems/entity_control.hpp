@@ -13,5 +13,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
+void sample_input(entt::registry &registry, entt::entity *cam, double deltaTime);
+
 void entity_control(entt::registry &registry, entt::entity *cam, GLFWwindow *window, double deltaTime);
 
@@ -0,0 +1,100 @@
+#include <algorithm>
+
+#include "fish_culling.hpp"
+#include "../components/quantize.hpp"
+#include "../gl_state.hpp"
+
+#define CULL_GROUP_SIZE 64 // the local size of compute_cull_fish.glsl
+
+fish_culling::fish_culling() {
+    if (!GLAD_GL_VERSION_4_3) return;
+
+    // the buckets depend on MAX_LODS, so the shader is given their layout rather than keeping its own copy
+    this->cullShader.emplace("shaders/compute_cull_fish.glsl", std::vector<std::pair<std::string, long>>{
+            {"BUCKETS", BUCKETS},
+            {"BUCKET_FADE", BUCKET_FADE},
+            {"BUCKET_IMPOSTOR", BUCKET_IMPOSTOR},
+            {"COMMAND_FADE_IMPOSTOR", COMMAND_FADE_IMPOSTOR},
+            {"COMMAND_IMPOSTOR", COMMAND_IMPOSTOR},
+    });
+    glGenBuffers(1, &this->outputBuffer);
+    glGenBuffers(1, &this->commandBuffer);
+    gl_state::getInstance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, COMMANDS * 5 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+}
+
+bool fish_culling::supported() const {
+    return this->cullShader.has_value() && this->cullShader->ready();
+}
+
+void fish_culling::run(GLuint instanceBuffer, size_t offset, size_t count, bool quantized,
+                       const std::array<glm::vec4, 7> &planes, const glm::vec4 &depth,
+                       const std::array<float, BUCKETS - 1> &bucketDistances, float radius,
+                       const std::array<mesh_lod, COMMANDS> &meshes) {
+    gl_state &state = gl_state::getInstance();
+    const size_t recordSize = quantized ? 8 * sizeof(uint16_t) : 8 * sizeof(float);
+
+    // room for every fish in every bucket, so no bucket can run over the next
+    const size_t outputSize = BUCKETS * std::max<size_t>(count, 1) * recordSize;
+    if (outputSize > this->outputSize) {
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, this->outputBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, outputSize, nullptr, GL_DYNAMIC_COPY);
+        this->outputSize = outputSize;
+    }
+
+    // the commands start empty, the shader counts the instances into them
+    GLuint commands[COMMANDS][5];
+    for (size_t command = 0; command < COMMANDS; command++) {
+        const size_t bucket = command == COMMAND_FADE_IMPOSTOR ? BUCKET_FADE
+                              : command == COMMAND_IMPOSTOR ? BUCKET_IMPOSTOR
+                              : command;
+        commands[command][0] = (GLuint) meshes[command].indices;
+        commands[command][1] = 0;
+        commands[command][2] = meshes[command].firstIndex;
+        commands[command][3] = (GLuint) meshes[command].baseVertex;
+        commands[command][4] = (GLuint) (bucket * count);
+    }
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+    if (count == 0) return;
+
+    // the stream regions need not meet the storage buffer offset alignment, so the
+    // whole buffer is bound and the shader skips to the region itself
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->outputBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->commandBuffer);
+
+    shader &cull = *this->cullShader;
+    cull.use();
+    cull.setInteger("instanceCount", (int) count);
+    cull.setInteger("inputOffset", (int) (offset / sizeof(GLuint)));
+    cull.setInteger("recordWords", (int) (recordSize / sizeof(GLuint)));
+    cull.setInteger("quantized", quantized);
+    cull.setVector("instanceScale", glm::vec3(quantized ? 2.0f * TANK_EXTENT : 1.0f));
+    cull.setVector("instanceOffset", glm::vec3(quantized ? -TANK_EXTENT : 0.0f));
+    cull.setVector4Array("planes", planes.data(), planes.size());
+    cull.setVector4("depthRow", depth);
+    cull.setFloatArray("bucketDistances", bucketDistances.data(), bucketDistances.size());
+    cull.setFloat("radius", radius);
+    glDispatchCompute((GLuint) ((count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+
+    // the draws read both the counts and the instances the shader wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+GLuint fish_culling::output() const {
+    return this->outputBuffer;
+}
+
+GLuint fish_culling::commands() const {
+    return this->commandBuffer;
+}
+
+void fish_culling::close() {
+    // the buffers and program are made along with the shader, whether or not it has linked
+    if (!this->cullShader.has_value()) return;
+
+    gl_state::getInstance().deleteBuffer(this->outputBuffer);
+    gl_state::getInstance().deleteBuffer(this->commandBuffer);
+    this->cullShader->close();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <stddef.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../components/render.hpp"
+
+// the fish are drawn in buckets, one per level of detail, then those fading
+// into impostors, then those drawn only as impostors
+enum fish_bucket : size_t {
+    BUCKET_FADE = MAX_LODS,
+    BUCKET_IMPOSTOR,
+    BUCKETS,
+};
+
+// the indirect draws of the buckets, which match them up to the fading
+// fish, as those are drawn twice, once as fish and once as impostors
+enum fish_command : size_t {
+    COMMAND_FADE_FISH = BUCKET_FADE,
+    COMMAND_FADE_IMPOSTOR,
+    COMMAND_IMPOSTOR,
+    COMMANDS,
+};
+
+/**
+ * Culls and buckets the flock in a compute shader, so the cpu packs every
+ * fish and never looks at whether they can be seen. The survivors of each
+ * bucket are compacted into their own range of one buffer, and counted
+ * straight into the indirect draws which read them.
+ *
+ * Compute shaders need GL 4.3, so on older contexts it is unsupported
+ * and the flock is culled on the cpu instead, as it is while the cull
+ * shader is still being compiled.
+ */
+class fish_culling {
+public:
+    fish_culling();
+
+    bool supported() const;
+
+    /**
+     * Culls the packed instances and writes the draws of each bucket.
+     * @param offset The byte offset of the instances in the buffer.
+     * @param meshes The range of indices each command draws.
+     * @param bucketDistances The clip space w past which each following bucket is used.
+     */
+    void run(GLuint instanceBuffer, size_t offset, size_t count, bool quantized,
+             const std::array<glm::vec4, 7> &planes, const glm::vec4 &depth,
+             const std::array<float, BUCKETS - 1> &bucketDistances, float radius,
+             const std::array<mesh_lod, COMMANDS> &meshes);
+
+    /**
+     * The buffer of culled instances, in the same packing as they were given.
+     * Each draw starts from its own range with its base instance.
+     */
+    GLuint output() const;
+
+    /**
+     * The buffer of DrawElementsIndirectCommands, one per fish_command.
+     */
+    GLuint commands() const;
+
+    void close();
+
+private:
+    std::optional<shader> cullShader;
+    GLuint outputBuffer = 0;
+    GLuint commandBuffer = 0;
+    size_t outputSize = 0;
+};
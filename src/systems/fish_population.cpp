@@ -9,6 +9,7 @@
 #include "fish_population.hpp"
 #include "../settings.hpp"
 #include "../components/components.hpp"
+#include "flock.hpp"
 
 #include "glm/gtc/quaternion.hpp"
 
@@ -18,6 +19,12 @@ static std::uniform_real_distribution<float> dist(-1, 1);
 
 #define SPAWN_LIMIT 1
 
+void initializeFishPopulation(entt::registry &registry) {
+    Settings::getInstance().subscribe(SETTINGS_STORAGE, [&registry](const settings_snapshot &s) {
+        convertFlock(registry, s.compact_fish);
+    });
+}
+
 /**
  * Handles the spawning and despawning of fish,
  * according to the value specified in the settings.
@@ -25,17 +32,23 @@ static std::uniform_real_distribution<float> dist(-1, 1);
  * Fish are spawned in and destroyed randomly.
  */
 void fish_population(entt::registry &registry) {
-    auto &s = Settings::getInstance();
+    const auto s = Settings::getInstance().snapshot();
 
-    auto fishView = registry.view<fish, position>();
-    int64_t fishDeficit = s.fish - fishView.size();
+    auto fishView = registry.view<fish>();
+    int64_t fishDeficit = s->fish - fishView.size();
     if (fishDeficit >= 0) {
         // create some (or none)
         for (int i = 0; i < fishDeficit && i < SPAWN_LIMIT; i++) {
             auto entity = registry.create();
-            registry.assign<position>(entity, glm::vec3(0, 1.5f + dist(eng), -8.0f + dist(eng)), glm::quatLookAt(glm::normalize(glm::vec3(-5.0f, dist(eng), dist(eng))), glm::vec3(0, 1, 0)));
-            registry.assign<velocity>(entity, glm::vec3(0, 0, 0));
-            registry.assign<fish>(entity, (uint8_t)(s.fish - fishDeficit + i) % 5);
+            position pos = {glm::vec3(0, 1.5f + dist(eng), -8.0f + dist(eng)), glm::quatLookAt(glm::normalize(glm::vec3(-5.0f, dist(eng), dist(eng))), glm::vec3(0, 1, 0))};
+            if (s->compact_fish) {
+                registry.assign<packed_position>(entity, packPosition(pos));
+                registry.assign<packed_velocity>(entity, packVelocity(glm::vec3(0, 0, 0)));
+            } else {
+                registry.assign<position>(entity, pos);
+                registry.assign<velocity>(entity, glm::vec3(0, 0, 0));
+            }
+            registry.assign<fish>(entity, (uint8_t)(s->fish - fishDeficit + i) % 5);
         }
     } else {
         // kill some
@@ -7,4 +7,9 @@
 #include <entt/entt.hpp>
 #include "../components/components.hpp"
 
+/**
+ * Moves the existing fish over whenever the storage setting changes.
+ */
+void initializeFishPopulation(entt::registry &registry);
+
 void fish_population(entt::registry &registry);
@@ -0,0 +1,113 @@
+#include "flock.hpp"
+#include "../components/components.hpp"
+#include "../components/quantize.hpp"
+
+packed_position packPosition(const position &pos) {
+    return {
+            quantizeAxis(pos.position.x, TANK_EXTENT),
+            quantizeAxis(pos.position.y, TANK_EXTENT),
+            quantizeAxis(pos.position.z, TANK_EXTENT),
+            0,
+            packOrientation(pos.orientation.x, pos.orientation.y, pos.orientation.z, pos.orientation.w),
+    };
+}
+
+packed_velocity packVelocity(const glm::vec3 &vel) {
+    return {floatToHalf(vel.x), floatToHalf(vel.y), floatToHalf(vel.z), 0};
+}
+
+static position unpackPosition(const packed_position &packed) {
+    float x, y, z, w;
+    unpackOrientation(packed.orientation, x, y, z, w);
+    return {
+            glm::vec3(dequantizeAxis(packed.x, TANK_EXTENT), dequantizeAxis(packed.y, TANK_EXTENT),
+                      dequantizeAxis(packed.z, TANK_EXTENT)),
+            glm::quat(w, x, y, z),
+    };
+}
+
+void gatherFlock(entt::registry &registry, flock &staged, bool compactOnly) {
+    staged.entities.clear();
+    if (!compactOnly) {
+        for (auto entity : registry.view<fish, position, velocity>()) staged.entities.push_back(entity);
+    }
+    staged.compactStart = staged.entities.size();
+
+    // line the velocities up with the positions so that both pools can be streamed
+    registry.sort<packed_velocity, packed_position>();
+    const entt::entity *compactEntities = registry.data<packed_position>();
+    staged.entities.insert(staged.entities.end(), compactEntities, compactEntities + registry.size<packed_position>());
+
+    auto &buffer = staged.buffer;
+    buffer.resize(staged.entities.size());
+    for (size_t i = 0; i < staged.compactStart; i++) {
+        auto [pos, vel] = registry.get<position, velocity>(staged.entities[i]);
+        buffer.px[i] = pos.position.x;
+        buffer.py[i] = pos.position.y;
+        buffer.pz[i] = pos.position.z;
+        buffer.qx[i] = pos.orientation.x;
+        buffer.qy[i] = pos.orientation.y;
+        buffer.qz[i] = pos.orientation.z;
+        buffer.qw[i] = pos.orientation.w;
+        buffer.vx[i] = vel.velocity.x;
+        buffer.vy[i] = vel.velocity.y;
+        buffer.vz[i] = vel.velocity.z;
+    }
+
+    simd::kernels().unpack(registry.raw<packed_position>(), registry.raw<packed_velocity>(), TANK_EXTENT,
+                           buffer.arrays(staged.compactStart));
+
+    for (size_t i = 0; i < staged.entities.size(); i++) {
+        buffer.group[i] = registry.get<fish>(staged.entities[i]).getGroup();
+    }
+}
+
+void scatterFlock(entt::registry &registry, const flock &staged, uint32_t fields) {
+    auto &buffer = staged.buffer;
+    for (size_t i = 0; i < staged.compactStart; i++) {
+        auto [pos, vel] = registry.get<position, velocity>(staged.entities[i]);
+        if (fields & FLOCK_POSITION) pos.position = {buffer.px[i], buffer.py[i], buffer.pz[i]};
+        if (fields & FLOCK_ORIENTATION) pos.orientation = glm::quat(buffer.qw[i], buffer.qx[i], buffer.qy[i], buffer.qz[i]);
+        if (fields & FLOCK_VELOCITY) vel.velocity = {buffer.vx[i], buffer.vy[i], buffer.vz[i]};
+    }
+
+    packed_position *positions = registry.raw<packed_position>();
+    packed_velocity *velocities = registry.raw<packed_velocity>();
+    for (size_t i = staged.compactStart; i < staged.entities.size(); i++) {
+        auto &pos = positions[i - staged.compactStart];
+        if (fields & FLOCK_POSITION) {
+            pos.x = quantizeAxis(buffer.px[i], TANK_EXTENT);
+            pos.y = quantizeAxis(buffer.py[i], TANK_EXTENT);
+            pos.z = quantizeAxis(buffer.pz[i], TANK_EXTENT);
+        }
+        if (fields & FLOCK_ORIENTATION) {
+            pos.orientation = packOrientation(buffer.qx[i], buffer.qy[i], buffer.qz[i], buffer.qw[i]);
+        }
+        if (fields & FLOCK_VELOCITY) {
+            velocities[i - staged.compactStart] = packVelocity({buffer.vx[i], buffer.vy[i], buffer.vz[i]});
+        }
+    }
+}
+
+void convertFlock(entt::registry &registry, bool compact) {
+    std::vector<entt::entity> entities;
+    if (compact) {
+        for (auto entity : registry.view<fish, position, velocity>()) entities.push_back(entity);
+        for (auto entity : entities) {
+            auto [pos, vel] = registry.get<position, velocity>(entity);
+            registry.assign<packed_position>(entity, packPosition(pos));
+            registry.assign<packed_velocity>(entity, packVelocity(vel.velocity));
+            registry.remove<position>(entity);
+            registry.remove<velocity>(entity);
+        }
+    } else {
+        for (auto entity : registry.view<fish, packed_position, packed_velocity>()) entities.push_back(entity);
+        for (auto entity : entities) {
+            auto [pos, vel] = registry.get<packed_position, packed_velocity>(entity);
+            registry.assign<position>(entity, unpackPosition(pos));
+            registry.assign<velocity>(entity, glm::vec3(halfToFloat(vel.x), halfToFloat(vel.y), halfToFloat(vel.z)));
+            registry.remove<packed_position>(entity);
+            registry.remove<packed_velocity>(entity);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "../simd/kernels.hpp"
+#include "../components/physics.hpp"
+
+enum flock_field : uint32_t {
+    FLOCK_POSITION = 1u << 0u,
+    FLOCK_ORIENTATION = 1u << 1u,
+    FLOCK_VELOCITY = 1u << 2u,
+};
+
+/**
+ * The fish in the registry, staged as arrays for the simd kernels,
+ * whichever way their components are stored.
+ */
+struct flock {
+    simd::flock_buffer buffer;
+    std::vector<entt::entity> entities;
+    size_t compactStart; // the entities from here on are in compact storage
+};
+
+/**
+ * Stages the position, orientation, velocity and group of every fish,
+ * decoding fish in compact storage straight from their pools.
+ *
+ * @param compactOnly Whether to skip the fish with full precision components.
+ */
+void gatherFlock(entt::registry &registry, flock &staged, bool compactOnly = false);
+
+/**
+ * Writes the given fields back to the fish they were gathered from.
+ * @note No fish may be created or destroyed between gathering and scattering.
+ */
+void scatterFlock(entt::registry &registry, const flock &staged, uint32_t fields);
+
+packed_position packPosition(const position &pos);
+
+packed_velocity packVelocity(const glm::vec3 &vel);
+
+/**
+ * Moves every fish into compact or full precision storage.
+ */
+void convertFlock(entt::registry &registry, bool compact);
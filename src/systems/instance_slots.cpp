@@ -0,0 +1,86 @@
+#include <glm/glm.hpp>
+
+#include "instance_slots.hpp"
+#include "../components/components.hpp"
+#include "../gl_state.hpp"
+
+instance_slots::instance_slots() {
+    glGenTextures(1, &this->textureID);
+    this->grow(256);
+}
+
+void instance_slots::update(entt::registry &registry) {
+    // some slots are owned by fish which were destroyed, so find and free them
+    if (registry.view<fish, instance_slot>().size() < this->live) {
+        for (uint32_t slot = 0; slot < this->owners.size(); slot++) {
+            entt::entity owner = this->owners[slot];
+            if (owner == entt::null || (registry.valid(owner) && registry.has<fish, instance_slot>(owner))) continue;
+
+            this->owners[slot] = entt::null;
+            this->freeSlots.push_back(slot);
+            this->live--;
+        }
+    }
+
+    auto unassigned = registry.view<fish>(entt::exclude<instance_slot>);
+    std::vector<entt::entity> spawned(unassigned.begin(), unassigned.end());
+    if (spawned.empty()) return;
+
+    if (this->live + spawned.size() > this->capacity) {
+        size_t slots = this->capacity;
+        while (slots < this->live + spawned.size()) slots *= 2;
+        this->grow(slots);
+    }
+
+    // upload only the attributes of the new fish
+    gl_state::getInstance().bindBuffer(GL_TEXTURE_BUFFER, this->bufferID);
+    for (entt::entity entity : spawned) {
+        uint32_t slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+        this->owners[slot] = entity;
+        this->live++;
+
+        auto &f = registry.get<fish>(entity);
+        glm::vec2 attributes(f.getTimeOffset(), f.getHueShift());
+        glBufferSubData(GL_TEXTURE_BUFFER, slot * sizeof(glm::vec2), sizeof(glm::vec2), &attributes);
+        registry.assign<instance_slot>(entity, slot);
+    }
+}
+
+size_t instance_slots::slotCount() const {
+    return this->capacity;
+}
+
+GLuint instance_slots::texture() const {
+    return this->textureID;
+}
+
+void instance_slots::close() {
+    gl_state::getInstance().deleteTexture(this->textureID);
+    gl_state::getInstance().deleteBuffer(this->bufferID);
+}
+
+/**
+ * Moves the attributes into a larger buffer, keeping every slot where it is.
+ */
+void instance_slots::grow(size_t slots) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    gl_state::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, slots * sizeof(glm::vec2), nullptr, GL_STATIC_DRAW);
+
+    if (this->bufferID) {
+        gl_state::getInstance().bindBuffer(GL_COPY_READ_BUFFER, this->bufferID);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, this->capacity * sizeof(glm::vec2));
+        gl_state::getInstance().deleteBuffer(this->bufferID);
+    }
+
+    gl_state::getInstance().bindTexture(GL_TEXTURE_BUFFER, this->textureID);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, buffer);
+
+    // hand out the new slots lowest first
+    for (size_t slot = slots; slot > this->capacity; slot--) this->freeSlots.push_back((uint32_t) slot - 1);
+    this->owners.resize(slots, entt::null);
+    this->bufferID = buffer;
+    this->capacity = slots;
+}
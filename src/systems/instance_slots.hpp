@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <entt/entt.hpp>
+
+/**
+ * Hands out stable slots in a buffer of per-fish attributes which never
+ * change, the time offset and hue shift. Spawning a fish uploads only its
+ * own slot, and despawning returns the slot to a free list with no upload
+ * at all, as instances look up their attributes by slot.
+ *
+ * The buffer doubles in capacity when full, and is exposed to the shader
+ * as a buffer texture.
+ */
+class instance_slots {
+public:
+    instance_slots();
+
+    /**
+     * Releases the slots of fish which no longer exist,
+     * and assigns slots to fish which don't have one.
+     */
+    void update(entt::registry &registry);
+
+    GLuint texture() const;
+
+    /**
+     * The slots the buffer has room for, every slot handed out is below this.
+     */
+    size_t slotCount() const;
+
+    void close();
+
+private:
+    GLuint bufferID = 0;
+    GLuint textureID = 0;
+    size_t capacity = 0;
+    std::vector<entt::entity> owners; // the fish in each slot, or null if the slot is free
+    std::vector<uint32_t> freeSlots;
+    size_t live = 0; // the number of slots in use
+
+    void grow(size_t slots);
+};
@@ -2,37 +2,63 @@
 // Created by Alexander Lyon on 2019-10-23.
 //
 
+#include <vector>
+
 #include <glm/gtc/quaternion.hpp>
 
 #include "physics.hpp"
+#include "flock.hpp"
 #include "../components/components.hpp"
 #include "../settings.hpp"
+#include "../simd/kernels.hpp"
 
 #define DRAG 0.001f
 
 static glm::vec3 forward = glm::vec3(0, 0, -1);
 
+static simd::flock_buffer staging;
+static std::vector<entt::entity> entities;
+static flock compactFish;
+
 /**
  * Newton's First Law:
  *
  * Objects in motion stay in motion,
  * objects at rest, stay at rest.
+ *
+ * Positions and velocities are staged into arrays
+ * and integrated by the simd kernels.
  */
 void physics(entt::registry &registry, double deltaTime) {
-    auto &s = Settings::getInstance();
+    const auto s = Settings::getInstance().snapshot();
 
     auto view = registry.view<position, velocity>();
-    for (auto entity : view) {
-        auto [pos, vel] = view.get<position, velocity>(entity);
-        pos.position += vel.velocity * (float) deltaTime * s.time_scale;
-
-        // apply drag
-        float dragForceMagnitude = pow(glm::length(vel.velocity), 2) * DRAG;
-        if (dragForceMagnitude > 0) {
-            auto dragForceVector = dragForceMagnitude * -glm::normalize(vel.velocity);
-            vel.velocity += dragForceVector;
-        }
+    entities.clear();
+    for (auto entity : view) entities.push_back(entity);
+
+    staging.resize(entities.size());
+    for (size_t i = 0; i < entities.size(); i++) {
+        auto [pos, vel] = view.get<position, velocity>(entities[i]);
+        staging.px[i] = pos.position.x;
+        staging.py[i] = pos.position.y;
+        staging.pz[i] = pos.position.z;
+        staging.vx[i] = vel.velocity.x;
+        staging.vy[i] = vel.velocity.y;
+        staging.vz[i] = vel.velocity.z;
     }
+
+    simd::kernels().integrate(staging.arrays(), (float) deltaTime * s->time_scale, DRAG);
+
+    for (size_t i = 0; i < entities.size(); i++) {
+        auto [pos, vel] = view.get<position, velocity>(entities[i]);
+        pos.position = {staging.px[i], staging.py[i], staging.pz[i]};
+        vel.velocity = {staging.vx[i], staging.vy[i], staging.vz[i]};
+    }
+
+    // fish in compact storage are decoded, integrated and encoded again
+    gatherFlock(registry, compactFish, true);
+    simd::kernels().integrate(compactFish.buffer.arrays(), (float) deltaTime * s->time_scale, DRAG);
+    scatterFlock(registry, compactFish, FLOCK_POSITION | FLOCK_VELOCITY);
 }
 
 /**
@@ -45,4 +71,14 @@ void fish_physics(entt::registry &registry, double) {
         auto [pos, vel] = view.get<position, velocity>(entity);
         vel.velocity = pos.orientation * forward * 5.0f;
     }
-}
\ No newline at end of file
+
+    gatherFlock(registry, compactFish, true);
+    auto &buffer = compactFish.buffer;
+    for (size_t i = 0; i < compactFish.entities.size(); i++) {
+        glm::vec3 vel = glm::quat(buffer.qw[i], buffer.qx[i], buffer.qy[i], buffer.qz[i]) * forward * 5.0f;
+        buffer.vx[i] = vel.x;
+        buffer.vy[i] = vel.y;
+        buffer.vz[i] = vel.z;
+    }
+    scatterFlock(registry, compactFish, FLOCK_VELOCITY);
+}
@@ -2,6 +2,9 @@
 // Created by Alexander Lyon on 2019-10-11.
 //
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 
 #include <glad/glad.h>
@@ -17,8 +20,16 @@
 #include "render.hpp"
 #include "../components/components.hpp"
 #include "../settings.hpp"
+#include "../simd/kernels.hpp"
+#include "../components/quantize.hpp"
+#include "flock.hpp"
+#include "../thread_pool.hpp"
+#include "../gl_state.hpp"
+#include "../asset_loader.hpp"
+#include "../shader_compiler.hpp"
 
 static double currentTime = 0;
+static frame_uniforms frame; // what was last written to the frame uniform buffer
 int windowWidth = 1280;
 int windowHeight = 720;
 
@@ -28,92 +39,292 @@ void window_size_callback(GLFWwindow*, int width, int height) {
 }
 
 /**
- * Renders all models with positions from the
- * perspective of the provided camera entity.
+ * Advances the clock and writes the view from the provided camera
+ * entity into the frame uniforms which every program reads.
  */
-void renderRenderables(entt::registry &registry, entt::entity *cam, double deltaTime) {
-    auto &s = Settings::getInstance();
-    currentTime += deltaTime * s.time_scale;
+void updateFrame(entt::registry &registry, entt::entity *cam, frame_uniform_buffer &frameUniforms, double deltaTime) {
+    const auto s = Settings::getInstance().snapshot();
+    currentTime += deltaTime * s->time_scale;
 
     auto cameras = registry.view<camera, position>();
     camera camData = cameras.get<camera>(*cam);
     position camPos = cameras.get<position>(*cam);
 
-    const glm::mat4 viewMatrix = glm::mat4_cast(camPos.orientation) * glm::translate(glm::mat4(1.0), -camPos.position);
-    const glm::mat4 projectionMatrix = glm::perspective(
+    frame.view = glm::mat4_cast(camPos.orientation) * glm::translate(glm::mat4(1.0), -camPos.position);
+    frame.projection = glm::perspective(
             glm::radians(*camData.fov),
             (float) windowWidth / windowHeight,
             0.1f,
             1000.0f
     );
+    frame.viewProjection = frame.projection * frame.view;
+    frame.cameraPos = glm::vec4(camPos.position, 1.0f);
+    frame.fogColor = glm::vec4(FOG_COLOR, 1.0f);
+    frame.backgroundColor = glm::vec4(BACKGROUND_COLOR, 1.0f);
+    frame.time = (float) currentTime;
+    frame.bpm = BPM;
+    frameUniforms.update(frame);
+}
 
-    // render all the renderables
-    auto renderableView = registry.view<renderable, position>();
-    for (auto entity : renderableView) {
-        auto [objPos, model] = renderableView.get<position, renderable>(entity);
-        model.render(objPos, camPos, projectionMatrix, viewMatrix, currentTime);
+/**
+ * Renders all models with world transforms from the
+ * perspective of the frame's camera.
+ */
+void renderRenderables(entt::registry &registry, render_queue &queue) {
+    // queue all the models using their cached world matrices, sorted and batched on flush
+    auto modelView = registry.view<model_handle, world_transform>();
+    for (auto entity : modelView) {
+        auto [transform, model] = modelView.get<world_transform, model_handle>(entity);
+        const float depth = -(frame.view * transform.matrix[3]).z;
+        queue.submit(model, transform.matrix, depth);
     }
+    queue.flush();
 }
 
-static size_t fishCount = 0;
+static flock instances;
+static simd::flock_buffer visibleInstances;
 
-void renderFish(entt::registry &registry, entt::entity *cam, shader fishShader, renderable fishModel, GLuint modelBuffer,
-                GLuint timeBuffer, GLuint hueBuffer) {
-    auto cameras = registry.view<camera, position>();
-    camera camData = cameras.get<camera>(*cam);
-    position camPos = cameras.get<position>(*cam);
+static std::array<size_t, BUCKETS + 1> bucketStart; // where each bucket's fish begin in visibleInstances
 
-    const glm::mat4 viewMatrix = glm::mat4_cast(camPos.orientation) * glm::translate(glm::mat4(1.0), -camPos.position);
-    const glm::mat4 projectionMatrix = glm::perspective(
-        glm::radians(*camData.fov),
-        (float) windowWidth / windowHeight,
-        0.1f,
-        1000.0f
-    );
+// the distance at which fragment_party_fish.glsl fades fully into the background
+#define FOG_DISTANCE 150.0f
+
+// the projected radius in pixels under which fish drop to the second level
+// of detail, and each level after that kicks in at half the size again
+#define LOD_PIXELS 48.0f
+
+// the projected radius in pixels under which fish are drawn as impostors,
+// and the fraction of that distance over which they fade in
+#define IMPOSTOR_PIXELS 10.0f
+#define IMPOSTOR_FADE 0.2f
+
+/**
+ * Extracts the six frustum planes from the view projection, plus a
+ * far plane where the fog hides everything behind it. Each is
+ * normalized with its normal facing inwards.
+ */
+static std::array<glm::vec4, 7> cullingPlanes(const glm::mat4 &viewProjection) {
+    const glm::mat4 rows = glm::transpose(viewProjection);
+    std::array<glm::vec4, 7> planes = {
+            rows[3] + rows[0], rows[3] - rows[0], // left, right
+            rows[3] + rows[1], rows[3] - rows[1], // bottom, top
+            rows[3] + rows[2], rows[3] - rows[2], // near, far
+            glm::vec4(0, 0, 0, FOG_DISTANCE) - rows[2], // clip space z matches screen.z in the shader
+    };
+    for (auto &plane : planes) plane /= glm::length(glm::vec3(plane));
+    return planes;
+}
+
+/**
+ * Compacts the fish which are on screen and not lost in the fog
+ * into visibleInstances, testing chunks of the flock in parallel.
+ * The survivors are bucketed by distance, starting at bucketStart.
+ *
+ * @param bucketDistances The clip space w past which each following bucket is used.
+ */
+static void cullFlock(const glm::mat4 &viewProjection, float radius,
+                      const std::array<float, BUCKETS - 1> &bucketDistances) {
+    static std::vector<int32_t> visible;
+    static std::vector<size_t> chunkVisible;
+    static std::vector<uint8_t> visibleBucket;
+    static std::vector<std::array<size_t, BUCKETS>> chunkBuckets;
+    static const size_t grain = 256;
+
+    const auto planes = cullingPlanes(viewProjection);
+    const glm::vec4 depth = glm::transpose(viewProjection)[3];
+    const size_t count = instances.entities.size();
+    const size_t chunks = (count + grain - 1) / grain;
+    visible.resize(count);
+    visibleBucket.resize(count);
+    chunkVisible.assign(chunks, 0);
+    chunkBuckets.assign(chunks, {});
+
+    auto &pool = thread_pool::getInstance();
+    pool.parallel_for(count, grain, [&](size_t begin, size_t end) {
+        simd::flock_arrays chunk = instances.buffer.arrays(begin);
+        chunk.count = end - begin;
+        const size_t found = simd::kernels().cull(chunk, glm::value_ptr(planes[0]), planes.size(), radius,
+                                                  visible.data() + begin);
+        chunkVisible[begin / grain] = found;
 
-    // batch all per-object data for calculation on the shader
-    auto fishView = registry.view<fish, position>();
-    std::vector<glm::mat4> modelMatrices;
-    std::vector<float> hueOffset;
-    std::vector<float> timeOffset;
-    modelMatrices.reserve(fishView.size());
-    hueOffset.reserve(fishView.size());
-    timeOffset.reserve(fishView.size());
-    for (entt::entity entity : fishView) {
-        auto [pos, f] = fishView.get<position, fish>(entity);
-        modelMatrices.push_back(projectionMatrix * viewMatrix * glm::translate(glm::mat4(1.0f), pos.position) * glm::mat4_cast(pos.orientation));
-        hueOffset.push_back(f.getHueShift());
-        timeOffset.push_back(f.getTimeOffset());
+        auto &buckets = chunkBuckets[begin / grain];
+        for (size_t i = begin; i < begin + found; i++) {
+            const int32_t j = visible[i];
+            const float w = depth.x * chunk.px[j] + depth.y * chunk.py[j] + depth.z * chunk.pz[j] + depth.w;
+
+            uint8_t bucket = 0;
+            while (bucket < bucketDistances.size() && w > bucketDistances[bucket]) bucket++;
+            visibleBucket[i] = bucket;
+            buckets[bucket]++;
+        }
+    });
+
+    // work out where each chunk's survivors go in each bucket, then copy them over
+    size_t total = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        bucketStart[bucket] = total;
+        for (auto &buckets : chunkBuckets) {
+            const size_t found = buckets[bucket];
+            buckets[bucket] = total;
+            total += found;
+        }
     }
+    bucketStart[BUCKETS] = total;
+    visibleInstances.resize(total);
+
+    const simd::flock_arrays from = instances.buffer.arrays();
+    const simd::flock_arrays to = visibleInstances.arrays();
+    pool.parallel_for(count, grain, [&](size_t begin, size_t) {
+        const size_t chunk = begin / grain;
+        auto &next = chunkBuckets[chunk];
+        for (size_t i = begin; i < begin + chunkVisible[chunk]; i++) {
+            const size_t source = begin + visible[i];
+            const size_t target = next[visibleBucket[i]]++;
+            to.px[target] = from.px[source];
+            to.py[target] = from.py[source];
+            to.pz[target] = from.pz[source];
+            to.qx[target] = from.qx[source];
+            to.qy[target] = from.qy[source];
+            to.qz[target] = from.qz[source];
+            to.qw[target] = from.qw[source];
+            to.slot[target] = from.slot[source];
+        }
+    });
+}
 
-    // matrices will change often, so stream draw and sub every frame the fish size doesnt change
-    glBindBuffer(GL_ARRAY_BUFFER, modelBuffer);
-    if (fishView.size() != fishCount) {
-        glBufferData(GL_ARRAY_BUFFER, fishView.size() * sizeof(glm::mat4), glm::value_ptr(modelMatrices.front()), GL_STREAM_DRAW);
+/**
+ * Points the fish instance attributes at the layout written by
+ * the pack kernels: a position followed by an orientation, either
+ * as floats or as normalized 16-bit values.
+ */
+static void setInstanceFormat(renderable &model, GLuint instanceBuffer, bool quantized, size_t offset) {
+    if (quantized) {
+        const GLsizei stride = 8 * sizeof(uint16_t);
+        model.addVertexAttributeInstance(3, instanceBuffer, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, offset);
+        model.addVertexAttributeInstance(4, instanceBuffer, 4, GL_SHORT, GL_TRUE, stride, offset + 4 * sizeof(uint16_t));
     } else {
-        glBufferSubData(GL_ARRAY_BUFFER, 0, fishView.size() * sizeof(glm::mat4), glm::value_ptr(modelMatrices.front()));
+        const GLsizei stride = 8 * sizeof(float);
+        model.addVertexAttributeInstance(3, instanceBuffer, 4, GL_FLOAT, GL_FALSE, stride, offset);
+        model.addVertexAttributeInstance(4, instanceBuffer, 4, GL_FLOAT, GL_FALSE, stride, offset + 4 * sizeof(float));
     }
+}
+
+/**
+ * Sets the uniforms which the fish and impostor shaders share.
+ */
+static void prepareFishShader(shader &fishShader, bool quantized) {
+    fishShader.use();
+    fishShader.setVector("instanceScale", glm::vec3(quantized ? 2.0f * TANK_EXTENT : 1.0f));
+    fishShader.setVector("instanceOffset", glm::vec3(quantized ? -TANK_EXTENT : 0.0f));
+    fishShader.setFloat("instanceSlotScale", quantized ? 65535.0f : 1.0f);
+    fishShader.setInteger("hueVariants", HUE_VARIANTS);
+}
 
-    // time and hue offset are unique to the fish and will not change unless the fishView changes, so static draw
-    if (fishView.size() != fishCount) {
-        glBindBuffer(GL_ARRAY_BUFFER, timeBuffer);
-        glBufferData(GL_ARRAY_BUFFER, fishView.size() * sizeof(float), &timeOffset.front(), GL_STATIC_DRAW);
+void renderFish(entt::registry &registry, shader fishShader, renderable fishModel,
+                swim_animation *swimAnimation, shader impostorShader, renderable impostorQuad,
+                impostor_atlas *impostors, stream_buffer &instanceStream, instance_slots &slots,
+                fish_culling &culling) {
+    const auto s = Settings::getInstance().snapshot();
+    if (!fishShader.ready()) return;
+
+    // make sure every fish has a slot for its static attributes before batching them up
+    slots.update(registry);
+    gatherFlock(registry, instances);
+    for (size_t i = 0; i < instances.entities.size(); i++) {
+        instances.buffer.slot[i] = (int32_t) registry.get<instance_slot>(instances.entities[i]).index;
     }
 
-    if (fishView.size() != fishCount) {
-        glBindBuffer(GL_ARRAY_BUFFER, hueBuffer);
-        glBufferData(GL_ARRAY_BUFFER, fishView.size() * sizeof(float), &hueOffset.front(), GL_STATIC_DRAW);
+    // work out how far away each bucket starts from the projected size of the fish,
+    // making sure they never start before the last
+    const float radius = fishModel.getBoundingRadius() + SWIM_MARGIN;
+    const float pixelRadius = radius * frame.projection[1][1] * windowHeight * 0.5f; // the size at w = 1
+    const bool baked = swimAnimation && impostors && impostorShader.ready();
+    const float impostorDistance = s->impostors && baked ? pixelRadius / IMPOSTOR_PIXELS : INFINITY;
+    const float fadeDistance = impostorDistance * (1.0f - IMPOSTOR_FADE);
+    std::array<float, BUCKETS - 1> bucketDistances;
+    for (size_t lod = 1; lod < MAX_LODS; lod++) {
+        bucketDistances[lod - 1] = lod < fishModel.getLodCount()
+                ? pixelRadius / (LOD_PIXELS / (float) (1u << (lod - 1)))
+                : INFINITY;
+    }
+    bucketDistances[BUCKET_FADE - 1] = fadeDistance;
+    bucketDistances[BUCKET_IMPOSTOR - 1] = impostorDistance;
+    for (size_t bucket = bucketDistances.size() - 1; bucket > 0; bucket--) {
+        bucketDistances[bucket - 1] = std::min(bucketDistances[bucket - 1], bucketDistances[bucket]);
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    fishShader.use();
-    fishShader.setFloat("time", (float) currentTime);
-    fishShader.setVector("cameraPos", camPos.position);
-    fishShader.prepareTextures();
+    // only the fish which can be seen are drawn, either every fish is packed and
+    // the gpu works out which, or only those found by culling them here are packed
+    const bool gpuCulling = s->gpu_culling && culling.supported();
+    if (!gpuCulling) cullFlock(frame.viewProjection, radius, bucketDistances);
+    const simd::flock_arrays packed = gpuCulling ? instances.buffer.arrays() : visibleInstances.arrays();
+    const size_t count = packed.count;
+
+    // the instance records are written by the simd kernels straight into the stream buffer,
+    // the shader applies the view projection
+    // past the slots a 16-bit lane can hold, fish would read another's attributes, so the float format is used
+    const bool quantized = s->quantized_instances && slots.slotCount() <= QUANTIZED_SLOTS;
+    const size_t instanceSize = quantized ? 8 * sizeof(uint16_t) : 8 * sizeof(float);
+    void *instanceData = instanceStream.map(std::max<size_t>(count, 1) * instanceSize);
+    if (quantized) {
+        simd::kernels().pack_quantized_instances(packed, TANK_EXTENT, (uint16_t *) instanceData);
+    } else {
+        simd::kernels().pack_instances(packed, (float *) instanceData);
+    }
+    const size_t offset = instanceStream.unmap();
+
+    if (gpuCulling) {
+        std::array<mesh_lod, COMMANDS> meshes;
+        for (size_t lod = 0; lod < MAX_LODS; lod++) meshes[lod] = fishModel.getLod(lod);
+        meshes[COMMAND_FADE_FISH] = fishModel.getLod(fishModel.getLodCount() - 1);
+        meshes[COMMAND_FADE_IMPOSTOR] = meshes[COMMAND_IMPOSTOR] = impostorQuad.getLod(0);
+        culling.run(instanceStream.id(), offset, count, quantized, cullingPlanes(frame.viewProjection),
+                    glm::transpose(frame.viewProjection)[3], bucketDistances, radius, meshes);
+    }
+
+    // one instanced draw per bucket, re-pointing the attributes at it as the region moves every frame anyway,
+    // or when culled on the gpu one indirect draw per bucket, whose counts never come back to the cpu
+    auto drawBucket = [&](renderable &model, size_t bucket, size_t lod, size_t command) {
+        if (gpuCulling) {
+            setInstanceFormat(model, culling.output(), quantized, 0);
+            model.drawIndirect(culling.commands(), command);
+            return;
+        }
+
+        const size_t bucketCount = bucketStart[bucket + 1] - bucketStart[bucket];
+        if (bucketCount == 0) return;
+        setInstanceFormat(model, instanceStream.id(), quantized, offset + bucketStart[bucket] * instanceSize);
+        model.draw(bucketCount, lod);
+    };
+
+    gl_state::getInstance().bindTexture(UNIT_INSTANCE_ATTRIBUTES, GL_TEXTURE_BUFFER, slots.texture());
+
+    prepareFishShader(fishShader, quantized);
+    if (baked) swimAnimation->prepare(fishShader);
     fishModel.setTextures();
-    fishModel.draw(fishView.size());
 
-    fishCount = fishView.size();
+    // the closest fish work out their swim cycle exactly, the rest can use the baked one
+    for (size_t lod = 0; lod < MAX_LODS; lod++) {
+        fishShader.setInteger("bakedAnimation", lod > 0 && s->baked_animation && baked);
+        drawBucket(fishModel, lod, lod, lod);
+    }
+
+    // fish fading out are drawn at the lowest detail, dithered against their impostors
+    fishShader.setVector2("fadeRange", glm::vec2(fadeDistance, impostorDistance));
+    drawBucket(fishModel, BUCKET_FADE, fishModel.getLodCount() - 1, COMMAND_FADE_FISH);
+    fishShader.setVector2("fadeRange", glm::vec2(1e9f, 2e9f));
+    fishShader.setInteger("bakedAnimation", false);
+
+    if (baked) {
+        prepareFishShader(impostorShader, quantized);
+        impostors->prepare(impostorShader);
+        impostorShader.setVector2("fadeRange", glm::vec2(fadeDistance, impostorDistance));
+        drawBucket(impostorQuad, BUCKET_FADE, 0, COMMAND_FADE_IMPOSTOR);
+        impostorShader.setVector2("fadeRange", glm::vec2(-2.0f, -1.0f));
+        drawBucket(impostorQuad, BUCKET_IMPOSTOR, 0, COMMAND_IMPOSTOR);
+    }
+
+    instanceStream.fence();
 }
 
 void renderUI() {
@@ -132,6 +343,12 @@ void renderUI() {
     ImGui::SliderInt("Fish Count", &settings.fish, 0, 1000);
     ImGui::ColorEdit3("Background Color", (float *) &settings.color);
     ImGui::SliderFloat("Time Scale", &settings.time_scale, 0.0f, 5.0f);
+    ImGui::Checkbox("Compact Storage", &settings.compact_fish);
+    ImGui::Checkbox("Quantized Instances", &settings.quantized_instances);
+    ImGui::Checkbox("Impostors", &settings.impostors);
+    ImGui::Checkbox("Baked Animation", &settings.baked_animation);
+    ImGui::Checkbox("GPU Culling", &settings.gpu_culling);
+    ImGui::SliderInt("Upload Budget (KB)", &settings.upload_budget, 64, 16384);
     ImGui::Separator();
     ImGui::Text("Swarm Settings");
     ImGui::SliderInt("Max Group Size", &settings.group_size, 0, 20);
@@ -139,8 +356,15 @@ void renderUI() {
     ImGui::SliderFloat("Minimum Distance (Boid)", &settings.min_boid_distance, 0.0f, 20.0f);
     ImGui::SliderFloat("Minimum Distance (Camera)", &settings.min_camera_distance, 0.0f, 20.0f);
     ImGui::Separator();
+    ImGui::Text("Kernels: %s", simd::kernels().name);
+    const gl_state_counts binds = gl_state::getInstance().frameCounts();
+    ImGui::Text("Binds: %zu issued, %zu skipped", binds.issued, binds.skipped);
+    ImGui::Text("Models loading: %zu", asset_loader::getInstance().pending());
+    ImGui::Text("Shaders compiling: %zu", shader_compiler::getInstance().pending());
     if (ImGui::Button("Quit")) std::exit(0);
     ImGui::End();
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // dear imgui binds its own program, buffers and textures
+    gl_state::getInstance().invalidate();
 }
@@ -6,16 +6,41 @@
 
 #include <entt/entt.hpp>
 #include "../components/render.hpp"
+#include "../components/impostor.hpp"
+#include "../components/swim_animation.hpp"
+#include "../stream_buffer.hpp"
+#include "instance_slots.hpp"
+#include "render_queue.hpp"
+#include "fish_culling.hpp"
+
+// covers the vertices pushed outside the bounding sphere by the swimming animation
+#define SWIM_MARGIN 0.5f
+
+// the colours the lighting shaders fog towards, and the tempo their lights flash to
+#define FOG_COLOR (glm::vec3(20, 23, 55) / 255.0f)
+#define BACKGROUND_COLOR glm::vec3(0.1f, 0.12f, 0.33f)
+#define BPM 125
 
 extern int windowWidth;
 extern int windowHeight;
 
 void window_size_callback(GLFWwindow*, int width, int height);
 
-void renderRenderables(entt::registry &registry, entt::entity *cam, double deltaTime);
-
-void renderFish(entt::registry &registry, entt::entity *cam, shader fishShader, renderable fishModel, GLuint modelBuffer,
-                GLuint timeBuffer, GLuint hueBuffer);
+void updateFrame(entt::registry &registry, entt::entity *cam, frame_uniform_buffer &frameUniforms, double deltaTime);
+
+void renderRenderables(entt::registry &registry, render_queue &queue);
+
+/**
+ * Draws the flock, bucketed by how much detail each fish needs. Until the fish
+ * has loaded and its swim cycle and impostors are baked, they're null and every
+ * fish is drawn at full detail, as the placeholder while it's still loading.
+ * Nothing is drawn until the fish shader has compiled, and no impostors until
+ * theirs has.
+ */
+void renderFish(entt::registry &registry, shader fishShader, renderable fishModel,
+                swim_animation *swimAnimation, shader impostorShader, renderable impostorQuad,
+                impostor_atlas *impostors, stream_buffer &instanceStream, instance_slots &slots,
+                fish_culling &culling);
 
 void renderUI();
 
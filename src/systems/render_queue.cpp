@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "render_queue.hpp"
+#include "../geometry_pool.hpp"
+#include "../gl_state.hpp"
+
+// the sort key from the most significant bits down, so draws sort by
+// program first, then material, then mesh, then front to back
+#define KEY_PROGRAM_BITS 8
+#define KEY_MATERIAL_BITS 12
+#define KEY_MESH_BITS 12
+#define KEY_DEPTH_BITS 32
+
+#define KEY_MESH_SHIFT KEY_DEPTH_BITS
+#define KEY_MATERIAL_SHIFT (KEY_MESH_SHIFT + KEY_MESH_BITS)
+#define KEY_PROGRAM_SHIFT (KEY_MATERIAL_SHIFT + KEY_MATERIAL_BITS)
+#define KEY_BATCH_MASK (~0ull << KEY_DEPTH_BITS) // the bits which must match for draws to be instanced together
+#define KEY_STATE_MASK (~0ull << KEY_MATERIAL_SHIFT) // the bits which must match for draws to share a multi-draw
+
+static bool sameMaterial(const material_textures &a, const material_textures &b) {
+    return a.diffuse == b.diffuse && a.roughness == b.roughness && a.metallic == b.metallic
+           && a.diffuseHues == b.diffuseHues;
+}
+
+/**
+ * Finds the id of a value in a list of those seen before, adding it if it's new.
+ */
+template<typename T, typename Equal>
+static uint64_t idOf(std::vector<T> &seen, const T &value, unsigned bits, const char *kind, Equal equal) {
+    auto found = std::find_if(seen.begin(), seen.end(), [&](const T &other) { return equal(other, value); });
+    if (found != seen.end()) return (uint64_t) (found - seen.begin());
+
+    if (seen.size() >= (1ull << bits)) {
+        std::cerr << "The render queue can't sort more than " << (1ull << bits) << " " << kind << "." << std::endl;
+        std::exit(1);
+    }
+    seen.push_back(value);
+    return seen.size() - 1;
+}
+
+render_queue::render_queue() : multiDraw(GLAD_GL_VERSION_4_3 != 0) {
+    // the geometry of every model, with a world matrix per instance in locations 3 to 6
+    glGenVertexArrays(1, &this->vertexArrayID);
+    geometry_pool::getInstance().setVertexFormat(this->vertexArrayID);
+    for (GLuint column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+}
+
+/**
+ * Points the world matrix attributes at the matrices from the given byte offset of the instance stream.
+ */
+void render_queue::setInstanceOffset(size_t offset) {
+    gl_state::getInstance().bindBuffer(GL_ARRAY_BUFFER, this->instanceStream.id());
+    for (GLuint column = 0; column < 4; column++) {
+        // see https://stackoverflow.com/a/26283148/4913983
+        GLvoid const *pointer = static_cast<char const *>(0) + offset + column * sizeof(glm::vec4);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, (GLsizei) sizeof(glm::mat4), pointer);
+    }
+}
+
+/**
+ * Builds the state bits of a model's sort key from the program, material and mesh it's drawn with.
+ */
+uint64_t render_queue::keyOf(const renderable &model) {
+    auto equal = [](auto a, auto b) { return a == b; };
+    const uint64_t program = idOf(this->programs, model.getShader().id(), KEY_PROGRAM_BITS, "programs", equal);
+    const uint64_t material = idOf(this->materials, model.getTextures(), KEY_MATERIAL_BITS, "materials", sameMaterial);
+    const uint64_t mesh = idOf(this->meshes, model.getLod(0).firstIndex, KEY_MESH_BITS, "meshes", equal);
+    return (program << KEY_PROGRAM_SHIFT) | (material << KEY_MATERIAL_SHIFT) | (mesh << KEY_MESH_SHIFT);
+}
+
+model_handle render_queue::add(const renderable &model) {
+    this->models.push_back(model);
+    this->modelKeys.push_back(this->keyOf(model));
+    this->keyedResident.push_back(model.resident());
+    return {(uint32_t) this->models.size() - 1};
+}
+
+void render_queue::submit(model_handle model, const glm::mat4 &world, float depth) {
+    if (!this->keyedResident[model.index] && this->models[model.index].resident()) {
+        this->modelKeys[model.index] = this->keyOf(this->models[model.index]);
+        this->keyedResident[model.index] = true;
+    }
+
+    // the bits of a positive float sort the same as the float itself
+    uint32_t depthBits;
+    depth = std::max(depth, 0.0f);
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    this->draws.push_back({this->modelKeys[model.index] | depthBits, model.index, (uint32_t) this->worlds.size()});
+    this->worlds.push_back(world);
+}
+
+void render_queue::flush() {
+    this->drawsMade = 0;
+    if (this->draws.empty()) return;
+
+    std::sort(this->draws.begin(), this->draws.end(), [](const queued_draw &a, const queued_draw &b) {
+        return a.key < b.key;
+    });
+
+    // write the world matrices out in draw order, so each batch is a contiguous range
+    auto *instances = (glm::mat4 *) this->instanceStream.map(this->draws.size() * sizeof(glm::mat4));
+    for (size_t i = 0; i < this->draws.size(); i++) {
+        instances[i] = this->worlds[this->draws[i].world];
+    }
+    const size_t instanceOffset = this->instanceStream.unmap();
+
+    // one command per batch, starting from the batch's first matrix
+    this->commands.clear();
+    this->commandModels.clear();
+    for (size_t first = 0; first < this->draws.size();) {
+        const uint64_t batch = this->draws[first].key & KEY_BATCH_MASK;
+        size_t last = first + 1;
+        while (last < this->draws.size() && (this->draws[last].key & KEY_BATCH_MASK) == batch) last++;
+
+        // any model in the batch will do, they all share a program, material and mesh
+        const mesh_lod &mesh = this->models[this->draws[first].model].getLod(0);
+        this->commands.push_back({(GLuint) mesh.indices, (GLuint) (last - first), mesh.firstIndex, mesh.baseVertex,
+                                  (GLuint) first});
+        this->commandModels.push_back(this->draws[first].model);
+        first = last;
+    }
+
+    size_t commandOffset = 0;
+    if (this->multiDraw) {
+        void *commandData = this->commandStream.map(this->commands.size() * sizeof(draw_command));
+        std::memcpy(commandData, this->commands.data(), this->commands.size() * sizeof(draw_command));
+        commandOffset = this->commandStream.unmap();
+        gl_state::getInstance().bindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandStream.id());
+    }
+
+    gl_state::getInstance().bindVertexArray(this->vertexArrayID);
+    this->setInstanceOffset(instanceOffset);
+
+    // the commands sharing a program and material go in one multi-draw, without it
+    // each is drawn on its own with the matrices re-pointed at its batch instead
+    auto stateOf = [&](size_t command) { return this->modelKeys[this->commandModels[command]] & KEY_STATE_MASK; };
+    for (size_t first = 0; first < this->commands.size();) {
+        size_t last = first + 1;
+        while (last < this->commands.size() && stateOf(last) == stateOf(first)) last++;
+
+        // a model whose program is still compiling is left out until it has linked
+        if (!this->models[this->commandModels[first]].prepare()) {
+            first = last;
+            continue;
+        }
+        if (this->multiDraw) {
+            const char *indirect = static_cast<char const *>(0) + commandOffset + first * sizeof(draw_command);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, indirect, (GLsizei) (last - first), 0);
+            this->drawsMade++;
+        } else {
+            for (size_t command = first; command < last; command++) {
+                const draw_command &draw = this->commands[command];
+                this->setInstanceOffset(instanceOffset + draw.baseInstance * sizeof(glm::mat4));
+                const char *indices = static_cast<char const *>(0) + draw.firstIndex * sizeof(uint32_t);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei) draw.count, GL_UNSIGNED_INT, indices,
+                                                  (GLsizei) draw.instanceCount, draw.baseVertex);
+                this->drawsMade++;
+            }
+        }
+        first = last;
+    }
+
+    this->instanceStream.fence();
+    if (this->multiDraw) this->commandStream.fence();
+    this->draws.clear();
+    this->worlds.clear();
+}
+
+size_t render_queue::drawCount() const {
+    return this->drawsMade;
+}
+
+void render_queue::close() {
+    this->instanceStream.close();
+    this->commandStream.close();
+    gl_state::getInstance().deleteVertexArray(this->vertexArrayID);
+}
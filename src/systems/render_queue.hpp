@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "../components/render.hpp"
+#include "../stream_buffer.hpp"
+
+/**
+ * Collects the draws of a frame as packed 64 bit sort keys, then draws
+ * them in order of program, material, mesh and depth. Draws which share
+ * a program, material and mesh are merged into one instanced draw, with
+ * their world matrices streamed as per-instance attributes.
+ *
+ * Every model lives in the geometry pool, so the queue draws them all
+ * from one vertex array. Where multi-draw indirect is available, all the
+ * meshes drawn with one program and material go in a single multi-draw,
+ * each command picking its matrices with its base instance.
+ *
+ * Models are registered once and referred to by a model_handle, whose
+ * shader takes the world matrix as a mat4 attribute at location 3.
+ * A model still loading is keyed as the placeholder it's drawn as, and
+ * keyed again by its own material and mesh once it's resident. Nothing
+ * is drawn with a program still being compiled.
+ */
+class render_queue {
+public:
+    render_queue();
+
+    /**
+     * Registers a model to be drawn through the queue.
+     */
+    model_handle add(const renderable &model);
+
+    /**
+     * Queues a model to be drawn this frame.
+     * @param depth The distance of the model in front of the camera.
+     */
+    void submit(model_handle model, const glm::mat4 &world, float depth);
+
+    /**
+     * Draws everything queued since the last flush, in as few draws as it can.
+     */
+    void flush();
+
+    /**
+     * The number of draws the last flush made.
+     */
+    size_t drawCount() const;
+
+    void close();
+
+private:
+    struct queued_draw {
+        uint64_t key;
+        uint32_t model;
+        uint32_t world; // the index of the world matrix
+    };
+
+    // laid out as glMultiDrawElementsIndirect reads it
+    struct draw_command {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    std::vector<renderable> models;
+    std::vector<uint64_t> modelKeys; // the program, material and mesh ids of each model, in place in the key
+    std::vector<bool> keyedResident; // whether each model's key was made once it was resident
+    std::vector<GLuint> programs;
+    std::vector<material_textures> materials;
+    std::vector<GLuint> meshes; // the first index of each mesh in the geometry pool
+    std::vector<queued_draw> draws;
+    std::vector<glm::mat4> worlds;
+    std::vector<draw_command> commands;
+    std::vector<uint32_t> commandModels; // a model to prepare for each command
+    GLuint vertexArrayID;
+    stream_buffer instanceStream;
+    stream_buffer commandStream;
+    bool multiDraw;
+    size_t drawsMade = 0;
+
+    void setInstanceOffset(size_t offset);
+
+    uint64_t keyOf(const renderable &model);
+};
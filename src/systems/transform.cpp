@@ -0,0 +1,37 @@
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "transform.hpp"
+#include "../components/components.hpp"
+
+static glm::mat4 modelMatrix(const position &pos) {
+    return glm::translate(glm::mat4(1.0f), pos.position) * glm::mat4_cast(pos.orientation);
+}
+
+/**
+ * Keeps the cached world matrix of every renderable up to date.
+ *
+ * Only entities whose position differs from the one their matrix
+ * was built from are rebuilt, so static props cost a comparison.
+ */
+void transforms(entt::registry &registry) {
+    // start tracking renderables that were created since the last frame
+    std::vector<entt::entity> untracked;
+    for (auto entity : registry.view<position, model_handle>(entt::exclude<world_transform>)) {
+        untracked.push_back(entity);
+    }
+    for (auto entity : untracked) {
+        auto &pos = registry.get<position>(entity);
+        registry.assign<world_transform>(entity, pos, modelMatrix(pos));
+    }
+
+    auto view = registry.view<position, world_transform>();
+    for (auto entity : view) {
+        auto [pos, transform] = view.get<position, world_transform>(entity);
+        if (pos.position == transform.source.position && pos.orientation == transform.source.orientation) continue;
+        transform.source = pos;
+        transform.matrix = modelMatrix(pos);
+    }
+}
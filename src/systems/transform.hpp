@@ -0,0 +1,5 @@
+#pragma once
+
+#include <entt/entt.hpp>
+
+void transforms(entt::registry &registry);
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <vector>
+
+#define STB_DXT_IMPLEMENTATION
+
+#include <stb_dxt.h>
+
+#include "compress.hpp"
+
+/**
+ * Halves a level in each direction, averaging each 2x2 square of texels.
+ * An odd texel at the edge is averaged with itself.
+ */
+static std::vector<uint8_t> downsample(const std::vector<uint8_t> &level, uint32_t width, uint32_t height) {
+    const uint32_t nextWidth = std::max(width / 2, 1u);
+    const uint32_t nextHeight = std::max(height / 2, 1u);
+    std::vector<uint8_t> next((size_t) nextWidth * nextHeight * 4);
+    for (uint32_t y = 0; y < nextHeight; y++) {
+        const uint32_t rows[2] = {std::min(y * 2, height - 1), std::min(y * 2 + 1, height - 1)};
+        for (uint32_t x = 0; x < nextWidth; x++) {
+            const uint32_t columns[2] = {std::min(x * 2, width - 1), std::min(x * 2 + 1, width - 1)};
+            for (int channel = 0; channel < 4; channel++) {
+                uint32_t sum = 2; // rounds to nearest
+                for (uint32_t row : rows) {
+                    for (uint32_t column : columns) sum += level[((size_t) row * width + column) * 4 + channel];
+                }
+                next[((size_t) y * nextWidth + x) * 4 + channel] = (uint8_t) (sum / 4);
+            }
+        }
+    }
+    return next;
+}
+
+void compressTexture(const uint8_t *rgba, uint32_t width, uint32_t height, ktx_texture &texture) {
+    const size_t texels = (size_t) width * height;
+    bool opaque = true;
+    for (size_t texel = 0; texel < texels && opaque; texel++) opaque = rgba[texel * 4 + 3] == 255;
+
+    texture.format = opaque ? KTX_FORMAT_BC1_RGB : KTX_FORMAT_BC3;
+    texture.width = width;
+    texture.height = height;
+    texture.levels.clear();
+
+    const size_t blockBytes = ktxBlockBytes(texture.format);
+    std::vector<uint8_t> level(rgba, rgba + texels * 4);
+    for (;;) {
+        const uint32_t blocksWide = (width + 3) / 4;
+        const uint32_t blocksHigh = (height + 3) / 4;
+        std::vector<uint8_t> blocks((size_t) blocksWide * blocksHigh * blockBytes);
+        uint8_t block[16 * 4];
+        for (uint32_t by = 0; by < blocksHigh; by++) {
+            for (uint32_t bx = 0; bx < blocksWide; bx++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    for (uint32_t x = 0; x < 4; x++) {
+                        const size_t from = ((size_t) std::min(by * 4 + y, height - 1) * width
+                                             + std::min(bx * 4 + x, width - 1)) * 4;
+                        std::copy(&level[from], &level[from] + 4, &block[(y * 4 + x) * 4]);
+                    }
+                }
+                stb_compress_dxt_block(&blocks[((size_t) by * blocksWide + bx) * blockBytes], block, !opaque,
+                                       STB_DXT_HIGHQUAL);
+            }
+        }
+        texture.levels.push_back(std::move(blocks));
+
+        if (width == 1 && height == 1) break;
+        level = downsample(level, width, height);
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ktx.hpp"
+
+/**
+ * Builds the whole mip chain of an image with a box filter, as glGenerateMipmap
+ * would at runtime, and compresses every level into 4x4 blocks: BC1 when every
+ * texel is opaque, BC3 when any isn't. Blocks hanging over the edge of a level
+ * repeat its last row and column.
+ *
+ * @param rgba The image, four bytes per texel, the top row first.
+ */
+void compressTexture(const uint8_t *rgba, uint32_t width, uint32_t height, ktx_texture &texture);
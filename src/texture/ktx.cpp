@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "ktx.hpp"
+
+// see https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html, everything is little endian
+static const uint8_t KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+#define KTX_WRITER "aquarium texbake"
+
+/**
+ * The start of the file, up to the level index.
+ */
+struct ktx_header {
+    uint8_t identifier[sizeof(KTX_IDENTIFIER)];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct ktx_level {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(ktx_header) == 80 && sizeof(ktx_level) == 24, "the ktx2 structures must be unpadded");
+
+uint32_t ktxBlockBytes(uint32_t format) {
+    switch (format) {
+        case KTX_FORMAT_BC1_RGB:
+            return 8;
+        case KTX_FORMAT_BC3:
+        case KTX_FORMAT_BC7:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Counts the levels of a full mip chain, down to 1x1.
+ */
+static uint32_t mipLevels(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while (std::max(width, height) >> levels) levels++;
+    return levels;
+}
+
+static size_t levelBytes(const ktx_texture &texture, uint32_t level) {
+    const size_t blocksWide = (std::max(texture.width >> level, 1u) + 3) / 4;
+    const size_t blocksHigh = (std::max(texture.height >> level, 1u) + 3) / 4;
+    return blocksWide * blocksHigh * ktxBlockBytes(texture.format);
+}
+
+std::string ktxTexturePath(const std::string &imagePath) {
+    const size_t extension = imagePath.find_last_of('.');
+    const size_t directory = imagePath.find_last_of("/\\");
+    if (extension == std::string::npos || (directory != std::string::npos && extension < directory)) {
+        return imagePath + KTX_EXTENSION;
+    }
+    return imagePath.substr(0, extension) + KTX_EXTENSION;
+}
+
+template<typename T>
+static void append(std::vector<uint8_t> &bytes, const T &value) {
+    const auto *from = reinterpret_cast<const uint8_t *>(&value);
+    bytes.insert(bytes.end(), from, from + sizeof(T));
+}
+
+static void pad(std::vector<uint8_t> &bytes, size_t alignment) {
+    while (bytes.size() % alignment) bytes.push_back(0);
+}
+
+/**
+ * Builds the basic data format descriptor of a block compressed format: its
+ * colour model, the 4x4 block and where each channel lies within it.
+ */
+static std::vector<uint8_t> formatDescriptor(uint32_t format) {
+    // the channel type and bit range of each sample
+    struct sample {
+        uint32_t offset, length, channel;
+    };
+    uint32_t model;
+    sample samples[2];
+    size_t sampleCount = 1;
+    switch (format) {
+        case KTX_FORMAT_BC1_RGB:
+            model = 128; // KHR_DF_MODEL_BC1A
+            samples[0] = {0, 64, 0};
+            break;
+        case KTX_FORMAT_BC3:
+            model = 130; // KHR_DF_MODEL_BC3, alpha then colour
+            samples[0] = {0, 64, 15};
+            samples[1] = {64, 64, 0};
+            sampleCount = 2;
+            break;
+        default:
+            model = 134; // KHR_DF_MODEL_BC7
+            samples[0] = {0, 128, 0};
+            break;
+    }
+
+    const auto blockSize = (uint32_t) (24 + 16 * sampleCount);
+    std::vector<uint8_t> descriptor;
+    append<uint32_t>(descriptor, 4 + blockSize); // dfdTotalSize
+    append<uint32_t>(descriptor, 0); // khronos, basic descriptor block
+    append<uint32_t>(descriptor, 2u | (blockSize << 16u)); // version 2
+    append<uint32_t>(descriptor, model | (1u << 8u) | (1u << 16u)); // bt709 primaries, linear transfer, straight alpha
+    append<uint32_t>(descriptor, 3u | (3u << 8u)); // 4x4x1x1 texel blocks, each stored less one
+    append<uint32_t>(descriptor, ktxBlockBytes(format)); // bytes in plane 0
+    append<uint32_t>(descriptor, 0);
+    for (size_t i = 0; i < sampleCount; i++) {
+        const sample &s = samples[i];
+        append<uint32_t>(descriptor, s.offset | ((s.length - 1) << 16u) | (s.channel << 24u));
+        append<uint32_t>(descriptor, 0); // sample position
+        append<uint32_t>(descriptor, 0); // lower
+        append<uint32_t>(descriptor, 0xFFFFFFFFu); // upper
+    }
+    return descriptor;
+}
+
+bool writeKtx(const std::string &path, const ktx_texture &texture) {
+    const uint32_t blockBytes = ktxBlockBytes(texture.format);
+    const uint32_t levelCount = mipLevels(texture.width, texture.height);
+    if (blockBytes == 0 || texture.levels.size() != levelCount) return false;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (texture.levels[level].size() != levelBytes(texture, level)) return false;
+    }
+
+    // the descriptor and the writer's name follow the level index, then
+    // the levels from the smallest up, each aligned to its blocks
+    const std::vector<uint8_t> descriptor = formatDescriptor(texture.format);
+    std::vector<uint8_t> keyValues;
+    const char key[] = "KTXwriter";
+    append<uint32_t>(keyValues, (uint32_t) (sizeof(key) + sizeof(KTX_WRITER)));
+    keyValues.insert(keyValues.end(), key, key + sizeof(key));
+    keyValues.insert(keyValues.end(), KTX_WRITER, KTX_WRITER + sizeof(KTX_WRITER));
+    pad(keyValues, 4);
+
+    ktx_header header{};
+    std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.vkFormat = texture.format;
+    header.typeSize = 1;
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = (uint32_t) (sizeof(ktx_header) + levelCount * sizeof(ktx_level));
+    header.dfdByteLength = (uint32_t) descriptor.size();
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t) keyValues.size();
+
+    std::vector<uint8_t> data;
+    std::vector<ktx_level> index(levelCount);
+    size_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        while ((offset + data.size()) % blockBytes) data.push_back(0);
+        index[level] = {offset + data.size(), texture.levels[level].size(), texture.levels[level].size()};
+        data.insert(data.end(), texture.levels[level].begin(), texture.levels[level].end());
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(ktx_level));
+    file.write(reinterpret_cast<const char *>(descriptor.data()), descriptor.size());
+    file.write(reinterpret_cast<const char *>(keyValues.data()), keyValues.size());
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+    return file.good();
+}
+
+bool readKtx(const std::string &path, ktx_texture &texture) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) return false;
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    ktx_header header;
+    if (bytes.size() < sizeof(header)) return false;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    // anything but a plain 2d texture with its whole mip chain is treated as missing
+    texture.format = header.vkFormat;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    const size_t levelsAt = sizeof(header);
+    if (std::memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || ktxBlockBytes(header.vkFormat) == 0 || header.pixelWidth == 0 || header.pixelHeight == 0
+        || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1
+        || header.supercompressionScheme != 0 || header.levelCount != mipLevels(header.pixelWidth, header.pixelHeight)
+        || bytes.size() < levelsAt + header.levelCount * sizeof(ktx_level)) {
+        return false;
+    }
+
+    texture.levels.resize(header.levelCount);
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        ktx_level range;
+        std::memcpy(&range, bytes.data() + levelsAt + level * sizeof(ktx_level), sizeof(range));
+        if (range.byteLength != levelBytes(texture, level) || range.byteOffset > bytes.size()
+            || range.byteLength > bytes.size() - range.byteOffset) {
+            return false;
+        }
+        texture.levels[level].assign(bytes.begin() + (long) range.byteOffset,
+                                     bytes.begin() + (long) (range.byteOffset + range.byteLength));
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// the vulkan formats, which ktx2 names its formats by, of the block compressed textures supported
+#define KTX_FORMAT_BC1_RGB 131 // VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8 bytes per block
+#define KTX_FORMAT_BC3 137 // VK_FORMAT_BC3_UNORM_BLOCK, 16 bytes per block
+#define KTX_FORMAT_BC7 145 // VK_FORMAT_BC7_UNORM_BLOCK, 16 bytes per block
+
+#define KTX_EXTENSION ".ktx2"
+
+/**
+ * A block compressed 2d texture with its whole mip chain.
+ */
+struct ktx_texture {
+    uint32_t format; // one of the KTX_FORMATs
+    uint32_t width;
+    uint32_t height;
+    std::vector<std::vector<uint8_t>> levels; // the full size first, then each mip down to 1x1
+};
+
+/**
+ * Gets the bytes in each 4x4 block of a format, or 0 if it isn't supported.
+ */
+uint32_t ktxBlockBytes(uint32_t format);
+
+/**
+ * Gets where the compressed copy of an image lives, beside it with KTX_EXTENSION.
+ */
+std::string ktxTexturePath(const std::string &imagePath);
+
+/**
+ * Writes a texture out as a ktx2 file, without supercompression.
+ * @returns Whether it could be written.
+ */
+bool writeKtx(const std::string &path, const ktx_texture &texture);
+
+/**
+ * Reads a ktx2 file, checking it is a single 2d image in a supported
+ * format, without supercompression, and with its whole mip chain.
+ * @returns Whether it could be read, if not the image has to be decoded instead.
+ */
+bool readKtx(const std::string &path, ktx_texture &texture);
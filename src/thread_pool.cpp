@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+thread_pool::thread_pool() {
+    const unsigned cores = std::thread::hardware_concurrency();
+    for (unsigned i = 1; i < cores; i++) this->workers.emplace_back(&thread_pool::run, this);
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto &worker : this->workers) worker.join();
+}
+
+void thread_pool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+
+    // not worth waking anyone for a single chunk
+    if (chunks == 1 || this->workers.empty()) {
+        for (size_t begin = 0; begin < count; begin += grain) body(begin, std::min(begin + grain, count));
+        return;
+    }
+
+    job task{&body, count, grain, {0}, chunks};
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(&task);
+    }
+    this->wake.notify_all();
+
+    this->work(task);
+
+    // the job is on this stack, so every worker has to have left it too
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done.wait(lock, [&] { return task.pending == 0 && task.active == 0; });
+}
+
+size_t thread_pool::size() const {
+    return this->workers.size() + 1;
+}
+
+void thread_pool::run() {
+    for (;;) {
+        job *task;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+            if (this->stopping) return;
+            task = this->jobs.back();
+            task->active++;
+        }
+
+        this->work(*task);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (--task->active == 0) this->done.notify_all();
+    }
+}
+
+/**
+ * Claims and runs chunks of the given job until there are none left,
+ * then takes it down so no other worker picks it up.
+ */
+void thread_pool::work(job &task) {
+    size_t finished = 0;
+    for (;;) {
+        const size_t begin = task.next.fetch_add(1) * task.grain;
+        if (begin >= task.count) break;
+        (*task.body)(begin, std::min(begin + task.grain, task.count));
+        finished++;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto posted = std::find(this->jobs.begin(), this->jobs.end(), &task);
+    if (posted != this->jobs.end()) this->jobs.erase(posted);
+    task.pending -= finished;
+    if (task.pending == 0) this->done.notify_all();
+}
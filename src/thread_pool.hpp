@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * A fixed set of worker threads for splitting loops across cores.
+ * The calling thread works alongside them, so a pool with no
+ * workers simply runs everything on the caller.
+ *
+ * Several threads may run loops at once, such as the frame and the
+ * asset loaders. Each caller works through its own loop, and a free
+ * worker helps with whichever was posted last, so a short loop isn't
+ * left waiting behind a long one.
+ */
+class thread_pool {
+public:
+    static thread_pool &getInstance() {
+        static thread_pool instance;
+        return instance;
+    }
+
+    thread_pool(thread_pool const &) = delete;
+
+    void operator=(thread_pool const &) = delete;
+
+    ~thread_pool();
+
+    /**
+     * Runs the body over [0, count) in chunks of at most grain items,
+     * returning once every chunk is done. Chunks may run in any order.
+     */
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> &body);
+
+    /**
+     * The number of threads which run chunks, including the caller.
+     */
+    size_t size() const;
+
+private:
+    thread_pool();
+
+    /**
+     * One caller's loop, which lives on its stack until every chunk is done.
+     */
+    struct job {
+        const std::function<void(size_t, size_t)> *body;
+        size_t count;
+        size_t grain;
+        std::atomic<size_t> next{0}; // the next chunk to claim
+        size_t pending; // the chunks not yet finished
+        size_t active = 0; // the workers still looking at it
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake; // signalled when a job is posted
+    std::condition_variable done; // signalled when a job's last chunk finishes, or a worker leaves it
+    std::vector<job *> jobs; // those with chunks left to claim, oldest first
+    bool stopping = false;
+
+    void run();
+
+    void work(job &task);
+};
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <string>
+
+#include "../mesh/bake.hpp"
+
+/**
+ * Bakes each obj given into a binary mesh beside it, with its levels of detail
+ * generated, optimised and packed, so the aquarium can map it in at startup
+ * rather than parsing and processing the obj every time.
+ *
+ * Usage: meshbake <model.obj>...
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <model.obj>..." << std::endl;
+        return 1;
+    }
+
+    for (int arg = 1; arg < argc; arg++) {
+        const std::string model = argv[arg];
+        obj_model obj;
+        if (!loadObj(model, obj)) {
+            std::cerr << "Couldn't load file " << model << "." << std::endl;
+            return 1;
+        }
+
+        mesh_data mesh;
+        if (!bakeMesh(obj, mesh)) {
+            std::cerr << "Error parsing geometry for " << model << ". Are you only using triangles?" << std::endl;
+            return 1;
+        }
+
+        const std::string baked = bakedMeshPath(model);
+        if (!writeBakedMesh(baked, mesh.view())) {
+            std::cerr << "Couldn't write " << baked << "." << std::endl;
+            return 1;
+        }
+
+        std::cout << "Baked " << model << " into " << baked << ": " << mesh.vertices.size() << " vertices, "
+                  << mesh.indices.size() / 3 << " triangles over " << mesh.lods.size() << " levels of detail"
+                  << std::endl;
+    }
+
+    return 0;
+}
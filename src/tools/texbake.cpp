@@ -0,0 +1,50 @@
+#include <iostream>
+#include <string>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include "../texture/compress.hpp"
+
+/**
+ * Compresses each image given into a ktx2 beside it, with its whole mip
+ * chain precomputed, so the aquarium can upload the blocks as they are
+ * rather than decoding the image and generating its mips every time.
+ *
+ * Usage: texbake <image.png>...
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <image.png>..." << std::endl;
+        return 1;
+    }
+
+    for (int arg = 1; arg < argc; arg++) {
+        const std::string image = argv[arg];
+        int width, height, components;
+        uint8_t *rgba = stbi_load(image.c_str(), &width, &height, &components, STBI_rgb_alpha);
+        if (!rgba) {
+            std::cerr << "Unable to load texture: " << image << std::endl;
+            return 1;
+        }
+
+        ktx_texture texture;
+        compressTexture(rgba, (uint32_t) width, (uint32_t) height, texture);
+        stbi_image_free(rgba);
+
+        const std::string baked = ktxTexturePath(image);
+        if (!writeKtx(baked, texture)) {
+            std::cerr << "Couldn't write " << baked << "." << std::endl;
+            return 1;
+        }
+
+        size_t bytes = 0;
+        for (const auto &level : texture.levels) bytes += level.size();
+        std::cout << "Baked " << image << " into " << baked << ": " << width << "x" << height << " as "
+                  << (texture.format == KTX_FORMAT_BC1_RGB ? "BC1" : "BC3") << ", " << texture.levels.size()
+                  << " levels in " << bytes << " bytes" << std::endl;
+    }
+
+    return 0;
+}
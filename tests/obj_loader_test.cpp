@@ -0,0 +1,74 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../src/mesh/obj_loader.hpp"
+
+/**
+ * Compares what two loads of an obj gave, naming the first part which differs.
+ * @returns An empty string if they're the same.
+ */
+static std::string difference(const obj_model &expected, const obj_model &actual) {
+    const tinyobj::attrib_t &a = expected.attrib, &b = actual.attrib;
+    if (a.vertices != b.vertices) return "vertices";
+    if (a.colors != b.colors) return "vertex colours";
+    if (a.normals != b.normals) return "normals";
+    if (a.texcoords != b.texcoords) return "texture coordinates";
+    if (expected.materials.size() != actual.materials.size()) return "materials";
+    if (expected.shapes.size() != actual.shapes.size()) return "shape count";
+
+    for (size_t s = 0; s < expected.shapes.size(); s++) {
+        const tinyobj::shape_t &x = expected.shapes[s], &y = actual.shapes[s];
+        const std::string shape = "shape " + std::to_string(s) + " ";
+        if (x.name != y.name) return shape + "name";
+        if (x.mesh.indices.size() != y.mesh.indices.size()) return shape + "index count";
+        for (size_t i = 0; i < x.mesh.indices.size(); i++) {
+            const tinyobj::index_t &p = x.mesh.indices[i], &q = y.mesh.indices[i];
+            if (p.vertex_index != q.vertex_index || p.normal_index != q.normal_index ||
+                p.texcoord_index != q.texcoord_index) {
+                return shape + "index " + std::to_string(i);
+            }
+        }
+        if (x.mesh.num_face_vertices != y.mesh.num_face_vertices) return shape + "face sizes";
+        if (x.mesh.material_ids != y.mesh.material_ids) return shape + "materials";
+        if (x.mesh.smoothing_group_ids != y.mesh.smoothing_group_ids) return shape + "smoothing groups";
+    }
+    return "";
+}
+
+/**
+ * Checks the chunked parser gives what tinyobj does for an obj, however finely it's cut.
+ */
+static int checkObj(const std::string &path) {
+    obj_model expected;
+    if (!loadObj(path, expected, false)) {
+        std::cerr << "Couldn't load " << path << "." << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    std::stringstream text;
+    text << file.rdbuf();
+
+    int failures = 0;
+    for (size_t chunkBytes : {(size_t) OBJ_CHUNK_BYTES, (size_t) 64, (size_t) 1}) {
+        for (bool parallel : {false, true}) {
+            obj_model actual;
+            const bool parsed = parseObj(text.str(), path, actual, chunkBytes, parallel);
+            const std::string differs = parsed ? difference(expected, actual) : "whether it loads";
+            if (differs.empty()) continue;
+            std::cerr << "Cut into chunks of " << chunkBytes << " bytes" << (parallel ? " in parallel" : "")
+                      << ", " << path << " differs from tinyobj in its " << differs << "." << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    int failures = 0;
+    for (int arg = 1; arg < argc; arg++) failures += checkObj(argv[arg]);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
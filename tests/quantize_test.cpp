@@ -0,0 +1,121 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/components/physics.hpp"
+#include "../src/components/quantize.hpp"
+#include "../src/simd/kernels.hpp"
+
+// how far short of its heading a compact fish may stop, about what float manages
+#define TURN_TOLERANCE 0.003
+
+struct quaternion {
+    float x, y, z, w;
+};
+
+static double dot(const quaternion &a, const quaternion &b) {
+    return (double) a.x * b.x + (double) a.y * b.y + (double) a.z * b.z + (double) a.w * b.w;
+}
+
+/**
+ * Spherically interpolates along the shorter arc, as glm::slerp does.
+ */
+static quaternion slerp(const quaternion &from, quaternion to, float t) {
+    auto cosine = (float) dot(from, to);
+    if (cosine < 0) {
+        to = {-to.x, -to.y, -to.z, -to.w};
+        cosine = -cosine;
+    }
+    float a = 1.0f - t, b = t;
+    if (cosine < 1.0f - 1e-6f) {
+        const float angle = std::acos(cosine);
+        a = std::sin(a * angle) / std::sin(angle);
+        b = std::sin(b * angle) / std::sin(angle);
+    }
+    return {a * from.x + b * to.x, a * from.y + b * to.y, a * from.z + b * to.z, a * from.w + b * to.w};
+}
+
+static quaternion roundTrip(const quaternion &q) {
+    quaternion result;
+    unpackOrientation(packOrientation(q.x, q.y, q.z, q.w), result.x, result.y, result.z, result.w);
+    return result;
+}
+
+/**
+ * Turns a compact fish toward its heading for half a minute the way boids
+ * does, with its orientation packed between frames.
+ * @returns How far short of the heading it ends up, in radians.
+ */
+static double turn(const quaternion &start, const quaternion &target, float frameRate) {
+    quaternion q = roundTrip(start);
+    for (int frame = 0; frame < (int) (frameRate * 30.0f); frame++) {
+        q = roundTrip(slerp(q, target, 0.4f / frameRate));
+    }
+    return 2.0 * std::acos(std::min(std::fabs(dot(q, target)), 1.0));
+}
+
+/**
+ * Checks compact fish turn all the way to their heading at any frame rate.
+ */
+static int checkTurning() {
+    // a quarter turn about a skewed axis, and a heading only a little off the start
+    const float half = 0.5f * 1.5707963f;
+    const float axis = 1.0f / std::sqrt(3.0f);
+    const quaternion start = {0, 0, 0, 1};
+    const quaternion targets[] = {
+            {axis * std::sin(half), axis * std::sin(half), axis * std::sin(half), std::cos(half)},
+            {0, std::sin(0.1f), 0, std::cos(0.1f)},
+    };
+
+    int failures = 0;
+    for (const quaternion &target : targets) {
+        for (float frameRate : {30.0f, 60.0f, 144.0f}) {
+            const double remaining = turn(start, target, frameRate);
+            if (remaining > TURN_TOLERANCE) {
+                std::cerr << "A compact fish stopped turning " << remaining << " rad short of its heading at "
+                          << frameRate << " fps." << std::endl;
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+/**
+ * Checks the simd kernels decode packed orientations as unpackOrientation does.
+ */
+static int checkUnpack() {
+    std::mt19937 random(1);
+    std::normal_distribution<float> normal;
+    std::vector<packed_position> positions(1000);
+    std::vector<quaternion> expected(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        quaternion q = {normal(random), normal(random), normal(random), normal(random)};
+        const auto length = (float) std::sqrt(dot(q, q));
+        q = {q.x / length, q.y / length, q.z / length, q.w / length};
+        positions[i] = {0, 0, 0, 0, packOrientation(q.x, q.y, q.z, q.w)};
+        unpackOrientation(positions[i].orientation, expected[i].x, expected[i].y, expected[i].z, expected[i].w);
+    }
+
+    simd::flock_buffer buffer;
+    buffer.resize(positions.size());
+    simd::kernels().unpack(positions.data(), nullptr, TANK_EXTENT, buffer.arrays());
+
+    int failures = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        const quaternion q = {buffer.qx[i], buffer.qy[i], buffer.qz[i], buffer.qw[i]};
+        if (std::fabs(dot(q, expected[i])) < 1.0 - 1e-6) {
+            std::cerr << "The " << simd::kernels().name << " kernels unpacked orientation " << i
+                      << " differently." << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main() {
+    const int failures = checkTurning() + checkUnpack();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
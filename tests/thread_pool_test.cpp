@@ -0,0 +1,61 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/thread_pool.hpp"
+
+#define CALLERS 4 // the threads running loops at once, as the frame and asset loaders do
+#define ROUNDS 200
+
+/**
+ * Checks loops run from several threads at once each cover every item exactly once.
+ */
+static int checkConcurrentCallers() {
+    std::atomic<int> failures{0};
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < CALLERS; caller++) {
+        callers.emplace_back([&, caller] {
+            for (int round = 0; round < ROUNDS; round++) {
+                std::vector<std::atomic<int>> visits((size_t) (100 + caller * 37 + round));
+                thread_pool::getInstance().parallel_for(visits.size(), 3, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) visits[i]++;
+                });
+                for (const auto &count : visits) {
+                    if (count != 1) {
+                        failures++;
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &caller : callers) caller.join();
+
+    if (failures) std::cerr << failures << " loops run alongside others missed or repeated items." << std::endl;
+    return failures;
+}
+
+/**
+ * Checks a body may run a loop of its own.
+ */
+static int checkNested() {
+    std::atomic<size_t> total{0};
+    thread_pool::getInstance().parallel_for(16, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            thread_pool::getInstance().parallel_for(64, 4, [&](size_t innerBegin, size_t innerEnd) {
+                total += innerEnd - innerBegin;
+            });
+        }
+    });
+
+    if (total == 16 * 64) return 0;
+    std::cerr << "Nested loops covered " << total << " items rather than " << 16 * 64 << "." << std::endl;
+    return 1;
+}
+
+int main() {
+    const int failures = checkConcurrentCallers() + checkNested();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}